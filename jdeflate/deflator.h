@@ -72,10 +72,92 @@ typedef enum {
 
 /* Flags */
 typedef enum {
-	DEFLT_FIXEDCODES = 0x01
+	DEFLT_FIXEDCODES = 0x01,
+
+	/* levels 1 to 5, hash buckets of one cache line instead of hash chains,
+	 * it does less cache misses when the tables don't fit in the cache */
+	DEFLT_BUCKETHASH = 0x02,
+
+	/* levels 1 to 12, the window buffer is mapped twice in the address
+	 * space so the history is never moved, it's meant for long streams
+	 * (it takes a few system calls to create it and it doesn't use the
+	 * allocator, if the system doesn't support it the flag is ignored) */
+	DEFLT_MIRRORWINDOW = 0x04,
+
+	/* levels 2 to 9, the blocks are split where the estimated size of the
+	 * dynamic blocks (header included) is smaller than the size of a single
+	 * block, it helps with mixed content at some speed cost */
+	DEFLT_BLOCKSPLIT = 0x08,
+
+	/* levels 1 to 12, the blocks are encoded by a second thread while the
+	 * next block is parsed, the output is the same as without the flag (it
+	 * takes two more token buffers, their output and two window sized
+	 * buffers, the flag is ignored if the library is built without thread
+	 * support) */
+	DEFLT_PIPELINE = 0x10,
+
+	/* levels 1 to 7, the effort moves between levels 1 and 7 at the block
+	 * boundaries to keep the throughput set with deflator_settarget (it
+	 * takes the match finder memory of level 7 and DEFLT_BUCKETHASH is
+	 * ignored) */
+	DEFLT_GOVERNOR = 0x20
 } eDEFLTFlags;
 
 
+/* Values of the switches in TDeflatorParams */
+typedef enum {
+	DEFLT_PDEFAULT = 0,
+	DEFLT_PENABLE  = 1,
+	DEFLT_PDISABLE = 2
+} eDEFLTSwitch;
+
+
+/* Match finder parameters for deflator_createex, a zero field takes the
+ * value of the level (it's ignored at level 0) */
+struct TDeflatorParams {
+	uintxx flags;
+	intxx level;
+
+	/* log2 of the hash table size (8 to 20), it's not used with
+	 * DEFLT_BUCKETHASH */
+	uint32 hashbits;
+
+	/* max number of positions visited for each match search (the search
+	 * depth of the binary tree from level 8) */
+	uint32 maxchain;
+
+	/* the search stops at a match of nicelength bytes, levels 6 to 9 take
+	 * a match of goodlength bytes without looking at the next position
+	 * (3 to 258) */
+	uint32 nicelength;
+	uint32 goodlength;
+
+	/* levels 6 to 9, with DEFLT_PDISABLE every match is taken as it's found
+	 * (the same as goodlength 3) */
+	uint32 lazy;
+
+	/* levels 6 to 12, the 3 byte matches of the short hash table, levels 6
+	 * to 9 enable them from the data statistics by default */
+	uint32 shortmatches;
+
+	/* log2 of the token buffer size (12 to 20, 16 to 20 from level 10), a
+	 * block is never larger than the buffer */
+	uint32 tokenbits;
+
+	/* log2 of the window buffer size (16 to 24, 17 to 24 from level 10), a
+	 * larger buffer is moved less often */
+	uint32 windowbits;
+
+	/* max number of bytes taken by the instance (zero for no limit), the
+	 * window buffer, the token buffer and the hash table are made smaller
+	 * (below the values of the fields above) until it fits, at some ratio
+	 * cost */
+	uintxx memlimit;
+};
+
+typedef struct TDeflatorParams TDeflatorParams;
+
+
 /* Public struct.
  * This struct is mirrored internally in deflator.c. */
 struct TDeflator {
@@ -101,11 +183,35 @@ struct TDeflator {
 typedef struct TDeflator TDeflator;
 
 
+/* Dictionary with the match finder tables already built (see
+ * deflator_createdctnr) */
+typedef struct TDeflatorDctnr TDeflatorDctnr;
+
+
 /*
- * Create a deflator instance with the specified compression level. */
+ * Create a deflator instance with the specified compression level (0 to 12).
+ * Levels 10 to 12 use an optimal parser, they are much slower than level 9
+ * and only make sense when the data is compressed once and read many times.
+ * Levels 1 to 9 stop searching for matches in the parts of the input that
+ * look incompressible (already compressed data) and store them. */
 JDEFLATE_API
 TDeflator* deflator_create(uintxx flags, intxx level, const TAllocator*);
 
+/*
+ * Create a deflator instance with explicit match finder parameters, it
+ * returns NULL if any of them is out of range or the instance does not fit
+ * in memlimit. */
+JDEFLATE_API
+TDeflator* deflator_createex(const TDeflatorParams*, const TAllocator*);
+
+/*
+ * Get the number of bytes that deflator_createex requests from the allocator
+ * for the given parameters, or zero if they are not valid. The window of
+ * DEFLT_MIRRORWINDOW is counted as an allocated one and the thread stack of
+ * DEFLT_PIPELINE is not counted. */
+JDEFLATE_API
+uintxx deflator_memusage(const TDeflatorParams*);
+
 /*
  * Destroy a deflator instance. */
 JDEFLATE_API
@@ -142,16 +248,70 @@ uintxx deflator_tgtend(TDeflator*);
 JDEFLATE_API
 eDEFLTResult deflator_deflate(TDeflator*, eDEFLTFlush flush);
 
+/*
+ * Compress a whole buffer in one call (the deflator is reset first). The
+ * match finders work directly on the source buffer, there is no copy to
+ * the window. It returns the size of the compressed data or zero if the
+ * target is too small or the deflator is in an error state, a target of
+ * deflator_compressbound(size) bytes is always large enough. */
+JDEFLATE_API
+uintxx deflator_compressbuffer(TDeflator*, const uint8* source, uintxx size,
+	uint8* target, uintxx tsize);
+
+/*
+ * Maximum size of the compressed data for size bytes of input (any level). */
+JDEFLATE_API
+uintxx deflator_compressbound(uintxx size);
+
 /*
  * Set the dictionary for the deflator instance. */
 JDEFLATE_API
 void deflator_setdctnr(TDeflator*, const uint8* dict, uintxx size);
 
 /*
- * Reset the deflator instance to its initial state. */
+ * Create a dictionary with the match finder tables already built for the
+ * given parameters, it returns NULL at level 0 or if the parameters are not
+ * valid. It's not modified after the creation so any number of instances
+ * can use it at the same time (from any thread). */
+JDEFLATE_API
+TDeflatorDctnr* deflator_createdctnr(const TDeflatorParams*,
+	const uint8* dict, uintxx size, const TAllocator*);
+
+/*
+ * Destroy a dictionary, it must not be attached by another thread at the
+ * same time. */
+JDEFLATE_API
+void deflator_destroydctnr(TDeflatorDctnr*);
+
+/*
+ * Set a dictionary created with deflator_createdctnr, the same as
+ * deflator_setdctnr but the entries are copied instead of hashed when the
+ * instance was created with the same flags, level and hashbits. No reference
+ * to the dictionary is kept, it can be destroyed after the call. */
+JDEFLATE_API
+void deflator_attachdctnr(TDeflator*, const TDeflatorDctnr*);
+
+/*
+ * Reset the deflator instance to its initial state. The cost is proportional
+ * to the size of the last stream, the whole hash tables are only cleared
+ * when it moved the window or used DEFLT_FLUSH, every 2 GiB of positions
+ * (each stream takes its size plus 32 KiB) and with DEFLT_POSITION16. */
 JDEFLATE_API
 void deflator_reset(TDeflator*);
 
+/*
+ * Set the target throughput in MB/s (10^6 bytes per second) of an instance
+ * created with DEFLT_GOVERNOR. The time spent in deflator_deflate is
+ * measured and the level goes down when it's slower than the target and up
+ * when it's a quarter faster. Zero stops the governor at the current level.
+ * The target and the current level are kept by deflator_reset, the match
+ * finder parameters of deflator_createex only apply to the first level.
+ *
+ * The level changes depend on the wall clock, so the output with a target
+ * is not reproducible, it changes with the machine and its load. */
+JDEFLATE_API
+void deflator_settarget(TDeflator*, uintxx speed);
+
 
 /*
  * Inlines */
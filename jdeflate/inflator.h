@@ -97,6 +97,12 @@ typedef struct TInflator TInflator;
 JDEFLATE_API
 TInflator* inflator_create(uintxx flags, const TAllocator*);
 
+/*
+ * Get the number of bytes that an inflator instance requests from the
+ * allocator. */
+JDEFLATE_API
+uintxx inflator_memusage(void);
+
 /*
  * Destroy the inflator instance. */
 JDEFLATE_API
@@ -133,6 +139,15 @@ eINFLTResult inflator_inflate(TInflator*, uint32 final);
 JDEFLATE_API
 void inflator_setdctnr(TInflator*, const uint8* dict, uintxx size);
 
+/*
+ * Set the dictionary for the inflator without copying it, the back
+ * references that reach before the start of the stream are read from dict.
+ * The buffer is never modified so it can be shared by any number of
+ * instances, but it must not be freed until the stream ends or the instance
+ * is reset. */
+JDEFLATE_API
+void inflator_attachdctnr(TInflator*, const uint8* dict, uintxx size);
+
 /*
  * Reset the inflator to its initial state. */
 JDEFLATE_API
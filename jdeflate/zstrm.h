@@ -57,7 +57,10 @@ typedef enum {
 
 	/* Ignore checksums, only for inflate mode */
 	ZSTRM_NOCRC   = 0x04000000,
-	ZSTRM_NOADLER = 0x08000000
+	ZSTRM_NOADLER = 0x08000000,
+
+	/* Compress independent chunks in parallel, only for deflate mode */
+	ZSTRM_PARALLEL = 0x10000000
 } eZSTRMFlags;
 
 
@@ -167,6 +170,31 @@ void zstrm_settargetfn(const TZStrm*, TZStrmOFn fn, void* user);
 JDEFLATE_API
 void zstrm_setdctnr(const TZStrm*, const uint8* dict, uintxx size);
 
+/*
+ * Sets the number of worker threads used by a stream created with the
+ * ZSTRM_PARALLEL flag, it must be called before any data is compressed. The
+ * default is the number of online processors, zero compresses every chunk
+ * on the calling thread.
+ *
+ * In parallel mode the input is split in chunks of 128 KiB, each chunk is
+ * compressed using the previous 32 KiB of input as dictionary and ends with
+ * a sync flush. The output does not depend on the number of threads unless
+ * a throughput target is set with zstrm_settarget. The allocator must be
+ * thread safe when worker threads are used. */
+JDEFLATE_API
+void zstrm_setnthreads(const TZStrm*, uintxx n);
+
+/*
+ * Sets the throughput target in MB/s of a stream created with the
+ * DEFLT_GOVERNOR flag (see deflator_settarget), it must be called before any
+ * data is compressed. In parallel mode every worker adapts its own level.
+ *
+ * The level follows the measured time, so the output with a target is not
+ * reproducible, it changes with the machine, its load and the number of
+ * threads. */
+JDEFLATE_API
+void zstrm_settarget(const TZStrm*, uintxx speed);
+
 /*
  * Decompresses up to n bytes of data into the target buffer. The size of the
  * target buffer must be limited to 2^32 - 1 bytes.
@@ -16,6 +16,9 @@
 
 #include <jdeflate/deflator.h>
 #include <ctoolbox/ulog2.h>
+#include "vmirror.h"
+#include "threads.h"
+#include "timer.h"
 
 
 /* Deflate format definitions */
@@ -29,15 +32,19 @@
 #define WNDWBITS 15
 #define WNDWSIZE 32768
 
-/* Cache size */
+/* Cache size (HBITS is the default size of the head table, it's set for
+ * each instance) */
 #define HBITS 16
 #define CBITS WNDWBITS
 #define QBITS 14
 
-#define HMASK ((1ul << HBITS) - 1)
 #define CMASK ((1ul << CBITS) - 1)
 #define QMASK ((1ul << QBITS) - 1)
 
+/* Size of the regions checked by the incompressible data probe, with the
+ * longest match it must still be in the window when it's checked */
+#define PROBESIZE 0x4000
+
 
 /* Number of literals (including end of block), match symbols and precodes */
 #define MAXLTCODES 257
@@ -45,16 +52,62 @@
 #define MAXPCCODES 19
 
 
-/* */
+/* Hash positions (relative to whence4). The 32 bit positions only need to be
+ * rebased every 2 GiB of input, the 16 bit ones (DEFLT_POSITION16, half the
+ * memory) every 32 KiB */
+#if defined(DEFLT_POSITION16)
+	typedef  int16 TPosition;
+	typedef uint16 TUPosition;
+
+	#define REBASEPOINT 0x8000ul
+#else
+	typedef  int32 TPosition;
+	typedef uint32 TUPosition;
+
+	#define REBASEPOINT 0x80000000ul
+#endif
+
+
+/* x86 SSE2 (always present on x86-64) and AVX2 match length, the first 16
+ * bytes are compared inline and the rest by the best kernel for the CPU */
+#if defined(__SSE2__) || defined(_M_X64)
+	#if defined(__GNUC__) || defined(__MSVC__)
+		#define DEFLT_SIMDMATCH
+	#endif
+#endif
+
+
+/* The head table (mhlist) goes after the match finder structs, its size is
+ * set for each instance */
 struct TDEFLTPrvt1 {
-	uint16 mhlist[HMASK + 1];
-	uint16 mchain[CMASK + 1];
+	TPosition mchain[CMASK + 1];
+};
+
+/* Bucketed hash (level 1 to 5 with DEFLT_BUCKETHASH), each bucket takes a
+ * cache line and holds the most recent positions (a ring, from head upwards)
+ * with a check byte from the hash for each */
+#define BBITS 12
+#define BMASK ((1ul << BBITS) - 1)
+
+#define BUCKETSIZE ((64 - 4) / (sizeof(TPosition) + 1))
+
+struct TDEFLTBucket {
+	uint8 checks[BUCKETSIZE];
+	TPosition positions[BUCKETSIZE];
+	uint8 head;
+	uint8 padding[3];
+};
+
+struct TDEFLTPrvt1B {
+	struct TDEFLTBucket buckets[BMASK + 1];
+
+	/* to align the buckets to the cache line */
+	uint8 padding[64];
 };
 
 /* */
 struct TDEFLTPrvt2 {
-	uint16 mhlist[HMASK + 1];
-	uint16 mchain[CMASK + 1];
+	TPosition mchain[CMASK + 1];
 
 	uint16 shlist[QMASK + 1];
 	uint16 schain[QMASK + 1];
@@ -69,6 +122,61 @@ struct TDEFLTPrvt2 {
 	} stats[1];
 };
 
+/* Binary tree match finder (level 8 and above), two nodes per position: the
+ * first for the lesser suffixes and the second for the greater ones */
+struct TDEFLTBTree {
+	TPosition nodes[(CMASK + 1) << 1];
+};
+
+/* Optimal parser segment size (it must not be larger than the window size)
+ * and match cache size, a block can span several segments */
+#define OPTSEGMENTSIZE WNDWSIZE
+#define OPTCACHESIZE (OPTSEGMENTSIZE << 2)
+
+/* Max number of matches stored for a single position */
+#define OPTMAXMATCHES 32
+
+/* */
+struct TDEFLTPrvt3 {
+	/* matches found for each position of the segment, sorted by length */
+	struct TOptMatch {
+		uint16 length;
+		uint16 offset;
+	}
+	cache[OPTCACHESIZE];
+	uint8 counts[OPTSEGMENTSIZE];
+
+	/* cost from each position to the end of the segment and the chosen
+	 * literal or match at that position */
+	uint32 costs[OPTSEGMENTSIZE + 1];
+	struct TOptMatch path[OPTSEGMENTSIZE + 1];
+
+	/* symbol costs in bits (extra bits included) */
+	uint32 litcost[MAXLTCODES];
+	uint32 lnscost[MAXLZCODES];
+	uint32 dstcost[MAXLZCODES];
+
+	/* frequencies of the segments already parsed in the current block */
+	uintxx lfrqs[DEFLT_LMAXSYMBOL];
+	uintxx dfrqs[DEFLT_DMAXSYMBOL];
+};
+
+/* Block splitter (DEFLT_BLOCKSPLIT) */
+struct TDEFLTSplitter {
+	/* frequencies of the block up to the split point candidate */
+	uintxx lfrqs[DEFLT_LMAXSYMBOL];
+	uintxx dfrqs[DEFLT_DMAXSYMBOL];
+
+	/* frequencies of the tokens after the split point candidate, after a
+	 * split they are the ones moved to the next block */
+	uintxx tlfrqs[DEFLT_LMAXSYMBOL];
+	uintxx tdfrqs[DEFLT_DMAXSYMBOL];
+
+	/* split point candidate and number of moved tokens */
+	uintxx mark;
+	uintxx tail;
+};
+
 /* Private stuff */
 struct TDEFLTPrvt {
 	/* public fields */
@@ -116,41 +224,110 @@ struct TDEFLTPrvt {
 #endif
 	uintxx bcount;
 
+	/* window and lz buffer sizes (see getmeminfo) */
+	uintxx meminfo;
+
 	/* window buffer allocated space */
 	uint8* window;
 	uint8* windowend;
 
+	/* the window buffer, during a one-shot compression the window is the
+	 * source buffer until the last bytes */
+	uint8* wbuffer;
+
+	/* size of the window buffer when it's mirrored (DEFLT_MIRRORWINDOW),
+	 * zero otherwise */
+	uintxx mirror;
+
 	/* window span end (the used part of the window buffer) */
 	uint8* inputend;
 
+	/* window offset of the first byte that is not in an emitted block (it
+	 * wraps around when the byte is no longer in the window) */
+	uintxx bstart;
+
 	/* cursor, position in the window buffer */
 	uintxx cursor;
 	uintxx whence3;
 	uintxx whence4;
 
+	/* set when the short hash table can't be cleared at the hashes of the
+	 * stream positions and the window past the input is not zero (see
+	 * rewindcache) */
+	uint32 dirty;
+
+	/* incompressible data probe (level 1 to 9), the region ends at the
+	 * window offset pbend and pbmatch is the number of its bytes covered by
+	 * matches, rawcount is the number of regions passed through since
+	 * rawmode was set */
+	uintxx pbend;
+	uintxx pbmatch;
+	uint32 rawmode;
+	uint32 rawcount;
+
 	/* cache */
-	int16*  mhlist;
-	int16*  mchain;
+	TPosition* mhlist;
+	TPosition* mchain;
 	uint16* shlist;
 	uint16* schain;
 
+	/* binary tree match finder, when it's set mchain is not used */
+	TPosition* btree;
+
+	/* bucketed hash, when it's set mhlist and mchain are not used */
+	struct TDEFLTBucket* buckets;
+
 	/* match search parameters */
 	uint32 nicelength;
 	uint32 goodlength;
 	uint32 maxchain;
 
+#if defined(DEFLT_SIMDMATCH)
+	/* match length kernel for the CPU, each instance selects its own so
+	 * nothing is written to shared state when the threads start */
+	uint32 (*matchlength)(const uint8*, const uint8*);
+#endif
+
+	/* log2 of the head table size and the short matches mode (a
+	 * eDEFLTSwitch value, levels 6 to 12) */
+	uint32 hashbits;
+	uint32 shortmode;
+
+	/* throughput governor (DEFLT_GOVERNOR), the target is in nanoseconds
+	 * per KiB, the time and the input are counted from the last decision
+	 * and gvmark and gvsource are the start of the part of the current call
+	 * that is not counted yet */
+	uint32 gvtarget;
+	uint64 gvtime;
+	uintxx gvinput;
+	uint64 gvmark;
+	const uint8* gvsource;
+
+	/* number of parsing passes (optimal parser) */
+	uint32 passes;
+
 	/* block splitting stats */
 	struct TDEFLTStats* stats;
 
-	/* lz token and literal buffer */
-	uint16* lzlist;
-	uint16* lzlistend;
+	/* cost based block splitter, when it's set the stats are only used to
+	 * enable the short matches */
+	struct TDEFLTSplitter* splitter;
+
+	/* optimal parser data (level 10 11 12) */
+	struct TDEFLTPrvt3* oparser;
+
+	/* block encoder thread (DEFLT_PIPELINE) */
+	struct TDEFLTPipe* pipe;
+
+	/* lz token buffer (see addmatch for the token layout) */
+	uint32* lzlist;
+	uint32* lzlistend;
 
 	/* last lz token */
-	uint16* zend;
+	uint32* zend;
 
 	/* token index */
-	uint16* zptr;
+	uint32* zptr;
 
 	/* used for any level other than 0 */
 	struct TDEFLTExtra {
@@ -187,6 +364,14 @@ struct TDEFLTPrvt {
 		lnscodes[MAXLZCODES],
 		dstcodes[MAXLZCODES];
 
+		/* length codes with their extra bits appended (by length - 3), they
+		 * are set for every block from lnstable */
+		struct THCode3 {
+			uint8  length;
+			uint32 code;
+		}
+		lencodes[256];
+
 		/* encoding tables */
 		const struct THCode1* littable;
 		const struct THCode2* lnstable;
@@ -203,6 +388,67 @@ typedef union {
 } TDEFLTStaticAssert;
 
 
+#if defined(JDEFLATE_THREADS)
+
+/* Pipelined mode (DEFLT_PIPELINE) */
+struct TDEFLTJob {
+	uint32 state;
+	uint32 error;
+
+	/* level of the block when it was queued (the governor can change it
+	 * while the block is being encoded) */
+	int32 level;
+
+	/* block tokens (the end of block symbol is appended by the encoder) and
+	 * their frequencies */
+	uint32* tokens;
+	uintxx ntokens;
+	uintxx lfrqs[DEFLT_LMAXSYMBOL];
+	uintxx dfrqs[DEFLT_DMAXSYMBOL];
+
+	/* bytes of the block when it can be stored (a copy in sbuffer or the
+	 * one-shot source buffer), slength is zero when it can't be stored */
+	const uint8* stored;
+	uintxx slength;
+	uint8* sbuffer;
+
+	/* encoded block, ohead is the part already copied to the target */
+	uint8* output;
+	uintxx osize;
+	uintxx ohead;
+	uintxx ocapacity;
+};
+
+struct TDEFLTPipe {
+	/* a deflator state that only encodes blocks, its bit buffer is the
+	 * stream one while there are pending jobs */
+	struct TDEFLTPrvt encoder;
+	struct TDEFLTExtra extra;
+
+	/* the pending jobs (queued or not yet copied to the target) start at
+	 * head */
+	struct TDEFLTJob jobs[2];
+	uintxx head;
+	uintxx npending;
+
+	/* next job to be taken by the thread and number of queued jobs */
+	uintxx next;
+	uintxx nqueued;
+	uint32 quit;
+
+	/* size of the token and window sized buffers */
+	uintxx tsize;
+	uintxx wsize;
+
+	TThread thread;
+	TMutex mutex;
+	TCondition work;
+	TCondition done;
+};
+
+#endif
+
+
 /* window buffer size | lz buffer size */
 #define BUILDMEMINFO(A, B) (((A) << 0x08) | ((B) << 0x00))
 
@@ -213,24 +459,26 @@ getmeminfo(intxx level)
 		case 0:
 			return BUILDMEMINFO(WNDWBITS + 1, 0x00);
 		case 1:
-			return BUILDMEMINFO(WNDWBITS + 1, 0x0e);
+			return BUILDMEMINFO(WNDWBITS + 1, 0x0d);
 		case 2:
 		case 3:
 		case 4:
 		case 5:
-			return BUILDMEMINFO(WNDWBITS + 1, 0x0f);
+			return BUILDMEMINFO(WNDWBITS + 1, 0x0e);
 		case 6:
 		case 7:
-			return BUILDMEMINFO(WNDWBITS + 2, 0x10);
+			return BUILDMEMINFO(WNDWBITS + 2, 0x0f);
 		case 8:
 		case 9:
+			return BUILDMEMINFO(WNDWBITS + 2, 0x10);
+		case 10:
+		case 11:
+		case 12:
 			return BUILDMEMINFO(WNDWBITS + 2, 0x11);
 	}
 	return 0;
 }
 
-#undef BUILDMEMINFO
-
 #define GETWNBFFSZ(M) ((uintxx) 1L << (((M) >> 0x08) & 0xff))
 #define GETLZBFFSZ(M) ((uintxx) 1L << (((M) >> 0x00) & 0xff))
 
@@ -251,8 +499,15 @@ setparameters(struct TDEFLTPrvt* state, intxx level)
 		case 5: good =   8; nice =  64; chain = 128; break;
 		case 6: good =  16; nice =  16; chain =  48; break;
 		case 7: good =  32; nice =  64; chain = 128; break;
-		case 8: good =  64; nice = 128; chain = 320; break;
-		case 9: good = 192; nice = 256; chain = 512; break;
+
+		/* from here chain is the binary tree search depth */
+		case 8: good =  64; nice = 128; chain =  32; break;
+		case 9: good = 192; nice = 256; chain =  64; break;
+
+		/* the optimal parser does not use good */
+		case 10: good = 258; nice = 258; chain =  256; break;
+		case 11: good = 258; nice = 258; chain = 1024; break;
+		case 12: good = 258; nice = 258; chain = 4096; break;
 		default:
 			nice = 0; good = 0; chain = 0;
 			break;
@@ -260,6 +515,11 @@ setparameters(struct TDEFLTPrvt* state, intxx level)
 	PRVT->goodlength = good;
 	PRVT->nicelength = nice;
 	PRVT->maxchain   = chain;
+
+	PRVT->passes = 0;
+	if (level > 9) {
+		PRVT->passes = (uint32) (level - 8);
+	}
 }
 
 
@@ -267,40 +527,135 @@ static const struct THCode1* slitcodes;
 static const struct THCode2* slnscodes;
 static const struct THCode2* sdstcodes;
 
+/* Level of the match finder structs, the governor moves between levels 1
+ * and 7 so it takes the ones of level 7 */
+CTB_INLINE intxx
+getalloclevel(uintxx flags, intxx level)
+{
+	if ((flags & DEFLT_GOVERNOR) && level && level < 8) {
+		return 7;
+	}
+	return level;
+}
+
+/* Size of the block of allocateextra */
+static uintxx
+getextrasize(uintxx flags, intxx level, uintxx hashbits)
+{
+	uintxx n;
+	uintxx hsize;
+
+	n = sizeof(struct TDEFLTExtra);
+	hsize = sizeof(TPosition) << hashbits;
+	if (level > 5) {
+		n += sizeof(struct TDEFLTPrvt2);
+		if (level > 7) {
+			n += sizeof(struct TDEFLTBTree);
+		}
+		if (level > 9) {
+			n += sizeof(struct TDEFLTPrvt3);
+		}
+	}
+	else {
+		if (flags & DEFLT_BUCKETHASH) {
+			n += sizeof(struct TDEFLTPrvt1B);
+			hsize = 0;
+		}
+		else {
+			n += sizeof(struct TDEFLTPrvt1);
+		}
+	}
+
+	if (flags & DEFLT_BLOCKSPLIT) {
+		if (level > 1 && level < 10) {
+			n += sizeof(struct TDEFLTSplitter);
+		}
+	}
+	return n + hsize;
+}
+
 CTB_INLINE uintxx
 allocateextra(struct TDEFLTPrvt* state)
 {
 	uintxx i;
 	uintxx n;
+	uintxx splitter;
+	uintxx hsize;
+	intxx level;
 	struct TDEFLTExtra* e;
 	const struct TAllocator* a;
 
 	a = PRVT->allctr;
-	if (PRVT->level > 5) {
+	level = getalloclevel(PBLC->flags, PRVT->level);
+
+	/* the head table goes at the end */
+	hsize = sizeof(TPosition) << PRVT->hashbits;
+
+	/* the splitter goes after the extra struct (the size of both is a
+	 * multiple of sizeof(uintxx)) */
+	splitter = 0;
+	if (PBLC->flags & DEFLT_BLOCKSPLIT) {
+		if (level > 1 && level < 10) {
+			splitter = sizeof(struct TDEFLTSplitter);
+		}
+	}
+
+	if (level > 5) {
 		struct TDEFLTPrvt2* p2;
 
 		n = sizeof(struct TDEFLTExtra) + sizeof(struct TDEFLTPrvt2);
-		if ((e = a->request(n, a->user)) == NULL) {
+		if (level > 7) {
+			n += sizeof(struct TDEFLTBTree);
+		}
+		if (level > 9) {
+			n += sizeof(struct TDEFLTPrvt3);
+		}
+		if ((e = a->request(n + splitter + hsize, a->user)) == NULL) {
 			return 0;
 		}
-		p2 = (struct TDEFLTPrvt2*) (e + 1);
-		PRVT->mhlist = (int16*) p2->mhlist;
-		PRVT->mchain = (int16*) p2->mchain;
+		PRVT->mhlist = (TPosition*) (((uint8*) e) + n + splitter);
+
+		/* the optimal parser data goes first for the alignment */
+		p2 = (struct TDEFLTPrvt2*) (((uint8*) (e + 1)) + splitter);
+		if (level > 9) {
+			PRVT->oparser = (struct TDEFLTPrvt3*) (e + 1);
+			p2 = (struct TDEFLTPrvt2*) (PRVT->oparser + 1);
+		}
+		PRVT->mchain = p2->mchain;
 		PRVT->shlist = p2->shlist;
 		PRVT->schain = p2->schain;
 
 		PRVT->stats = p2->stats;
+		if (level > 7) {
+			PRVT->btree = ((struct TDEFLTBTree*) (p2 + 1))->nodes;
+		}
 	}
 	else {
-		struct TDEFLTPrvt1* p1;
+		if (PBLC->flags & DEFLT_BUCKETHASH) {
+			uintxx p;
 
-		n = sizeof(struct TDEFLTExtra) + sizeof(struct TDEFLTPrvt1);
-		if ((e = a->request(n, a->user)) == NULL) {
-			return 0;
+			n = sizeof(struct TDEFLTExtra) + sizeof(struct TDEFLTPrvt1B);
+			if ((e = a->request(n + splitter, a->user)) == NULL) {
+				return 0;
+			}
+			p = ((uintxx) (e + 1) + splitter + 63) & ((uintxx) ~63);
+			PRVT->buckets = (struct TDEFLTBucket*) p;
+		}
+		else {
+			struct TDEFLTPrvt1* p1;
+
+			n = sizeof(struct TDEFLTExtra) + sizeof(struct TDEFLTPrvt1);
+			if ((e = a->request(n + splitter + hsize, a->user)) == NULL) {
+				return 0;
+			}
+			p1 = (struct TDEFLTPrvt1*) (((uint8*) (e + 1)) + splitter);
+			PRVT->mchain = p1->mchain;
+			PRVT->mhlist = (TPosition*) (((uint8*) e) + n + splitter);
 		}
-		p1 = (struct TDEFLTPrvt1*) (e + 1);
-		PRVT->mhlist = (int16*) p1->mhlist;
-		PRVT->mchain = (int16*) p1->mchain;
+	}
+
+	if (splitter) {
+		PRVT->splitter = (struct TDEFLTSplitter*) (e + 1);
 	}
 
 	/* set the base and extra bit values */
@@ -339,6 +694,10 @@ allocatemem(struct TDEFLTPrvt* state, uintxx meminfo)
 	PRVT->schain = NULL;
 	PRVT->stats  = NULL;
 	PRVT->extra  = NULL;
+	PRVT->btree  = NULL;
+	PRVT->buckets = NULL;
+	PRVT->oparser = NULL;
+	PRVT->splitter = NULL;
 
 	wnsize = GETWNBFFSZ(meminfo) + WNDNGUARDSIZE;
 	lzsize = GETLZBFFSZ(meminfo);
@@ -346,16 +705,34 @@ allocatemem(struct TDEFLTPrvt* state, uintxx meminfo)
 		lzsize--;
 	}
 
+	PRVT->mirror = 0;
+	if ((PBLC->flags & DEFLT_MIRRORWINDOW) && PRVT->level) {
+		uintxx size;
+
+		/* the guard area is the start of the second view */
+		size = GETWNBFFSZ(meminfo);
+		buffer = vmirror_create(size);
+		if (buffer) {
+			PRVT->mirror    = size;
+			PRVT->window    = buffer;
+			PRVT->wbuffer   = buffer;
+			PRVT->windowend = PRVT->window + ((size << 1) - WNDNGUARDSIZE);
+			goto L_LZLIST;
+		}
+	}
+
 	buffer = a->request(wnsize * sizeof(PRVT->window[0]), a->user);
 	if (buffer == NULL) {
 		return 0;
 	}
 	PRVT->window    = buffer;
+	PRVT->wbuffer   = buffer;
     PRVT->windowend = PRVT->window + (wnsize - WNDNGUARDSIZE);
 	if (PRVT->level == 0) {
 		return 1;
 	}
 
+L_LZLIST:
     if (lzsize) {
 		buffer = a->request(lzsize * sizeof(PRVT->lzlist[0]), a->user);
 	    if (buffer == NULL) {
@@ -368,19 +745,233 @@ allocatemem(struct TDEFLTPrvt* state, uintxx meminfo)
 	return allocateextra(state);
 }
 
+/* Number of bytes requested from the allocator by an instance, a mirrored
+ * window is counted as an allocated one */
+static uintxx
+getmemusage(uintxx flags, intxx level, uintxx hashbits, uintxx meminfo)
+{
+	uintxx n;
+	uintxx wsize;
+	uintxx tsize;
+
+	wsize = GETWNBFFSZ(meminfo);
+	tsize = GETLZBFFSZ(meminfo);
+
+	n = sizeof(struct TDEFLTPrvt) + wsize + WNDNGUARDSIZE;
+	if (level == 0) {
+		return n;
+	}
+	n += tsize * sizeof(uint32);
+	n += getextrasize(flags, getalloclevel(flags, level), hashbits);
+
+#if defined(JDEFLATE_THREADS)
+	if (flags & DEFLT_PIPELINE) {
+		/* two jobs (see createpipe) */
+		n += sizeof(struct TDEFLTPipe);
+		n += (tsize * sizeof(uint32) + wsize + (tsize << 2) + 1024) << 1;
+	}
+#endif
+	return n;
+}
+
 #define SETERROR(ERROR) (PBLC->error = (ERROR))
 #define SETSTATE(STATE) (PBLC->state = (STATE))
 
 
+#if defined(JDEFLATE_THREADS)
+
+static bool createpipe(struct TDEFLTPrvt*, uintxx wsize, uintxx tsize);
+static void destroypipe(struct TDEFLTPrvt*);
+static void resetpipe(struct TDEFLTPrvt*);
+
+static uint32 queueblock(struct TDEFLTPrvt*);
+static uint32 drainpipe(struct TDEFLTPrvt*, uintxx keep);
+
+#endif
+
+/* Limits of the deflator_createex parameters */
+#define MINHASHBITS  8
+#define MAXHASHBITS 20
+#define MAXWNDWBITS 24
+#define MAXLZBFFBITS 20
+
+/* Validates the deflator_createex parameters, it returns the buffer sizes
+ * (see getmeminfo) and the hash table bits or zero if they are not valid or
+ * the instance does not fit in the memory limit */
+static uintxx
+checkparams(const TDeflatorParams* params, uint32* hashbits)
+{
+	uintxx wbits;
+	uintxx lbits;
+	uintxx hbits;
+	uintxx minwbits;
+	uintxx minlbits;
+	uintxx meminfo;
+	uintxx limit;
+	intxx level;
+
+	level = params->level;
+	if (level > 12 || level < 0) {
+		/* invalid level */
+		return 0;
+	}
+	meminfo = getmeminfo(level);
+	limit = params->memlimit;
+
+	hbits = HBITS;
+	*hashbits = HBITS;
+	if (level == 0) {
+		if (limit && getmemusage(params->flags, 0, 0, meminfo) > limit) {
+			return 0;
+		}
+		return meminfo;
+	}
+
+	if (params->hashbits) {
+		if (params->hashbits < MINHASHBITS || params->hashbits > MAXHASHBITS) {
+			return 0;
+		}
+		hbits = params->hashbits;
+	}
+	if (params->nicelength) {
+		if (params->nicelength < MINMATCH || params->nicelength > MAXMATCH) {
+			return 0;
+		}
+	}
+	if (params->goodlength) {
+		if (params->goodlength < MINMATCH || params->goodlength > MAXMATCH) {
+			return 0;
+		}
+	}
+	if (params->lazy > DEFLT_PDISABLE) {
+		return 0;
+	}
+	if (params->shortmatches > DEFLT_PDISABLE) {
+		return 0;
+	}
+
+	/* the optimal parser keeps a whole segment behind the cursor and it
+	 * needs room for one in the lz buffer */
+	minwbits = WNDWBITS + 1;
+	minlbits = 12;
+	if (level > 9) {
+		minwbits = WNDWBITS + 2;
+		minlbits = 16;
+	}
+
+	wbits = (meminfo >> 0x08) & 0xff;
+	if (params->windowbits) {
+		wbits = params->windowbits;
+		if (wbits < minwbits || wbits > MAXWNDWBITS) {
+			return 0;
+		}
+	}
+	lbits = (meminfo >> 0x00) & 0xff;
+	if (params->tokenbits) {
+		lbits = params->tokenbits;
+		if (lbits < minlbits || lbits > MAXLZBFFBITS) {
+			return 0;
+		}
+	}
+
+	/* the window goes down first (the input is just moved more often), then
+	 * the larger of the hash table and the token buffer */
+	while (limit) {
+		uintxx hsize;
+		uintxx n;
+
+		meminfo = BUILDMEMINFO(wbits, lbits);
+		n = getmemusage(params->flags, level, hbits, meminfo);
+		if (n <= limit) {
+			break;
+		}
+		if (wbits > minwbits) {
+			wbits--;
+			continue;
+		}
+
+		/* the buckets have a fixed size */
+		hsize = sizeof(TPosition) << hbits;
+		if (params->flags & DEFLT_BUCKETHASH) {
+			if (getalloclevel(params->flags, level) < 6) {
+				hsize = 0;
+			}
+		}
+		if (hsize && hbits > MINHASHBITS) {
+			if (hsize >= (sizeof(uint32) << lbits) || lbits == minlbits) {
+				hbits--;
+				continue;
+			}
+		}
+		if (lbits == minlbits) {
+			return 0;
+		}
+		lbits--;
+	}
+	*hashbits = (uint32) hbits;
+	return BUILDMEMINFO(wbits, lbits);
+}
+
+#undef MINHASHBITS
+#undef MAXHASHBITS
+#undef MAXWNDWBITS
+#undef MAXLZBFFBITS
+
+#undef BUILDMEMINFO
+
 TDeflator*
 deflator_create(uintxx flags, intxx level, const TAllocator* allctr)
+{
+	TDeflatorParams params;
+
+	params.flags = flags;
+	params.level = level;
+	params.hashbits   = 0;
+	params.maxchain   = 0;
+	params.nicelength = 0;
+	params.goodlength = 0;
+	params.lazy = 0;
+	params.shortmatches = 0;
+	params.tokenbits  = 0;
+	params.windowbits = 0;
+	params.memlimit   = 0;
+	return deflator_createex(&params, allctr);
+}
+
+uintxx
+deflator_memusage(const TDeflatorParams* params)
+{
+	uintxx meminfo;
+	uint32 hashbits;
+	CTB_ASSERT(params);
+
+	meminfo = checkparams(params, &hashbits);
+	if (meminfo == 0) {
+		return 0;
+	}
+	return getmemusage(params->flags, params->level, hashbits, meminfo);
+}
+
+#if defined(DEFLT_SIMDMATCH)
+static void setmatchlength(struct TDEFLTPrvt*);
+#endif
+
+TDeflator*
+deflator_createex(const TDeflatorParams* params, const TAllocator* allctr)
 {
 	struct TDeflator* state;
+	uintxx meminfo;
+	uintxx flags;
+	uint32 hashbits;
+	intxx level;
+	CTB_ASSERT(params);
 
-	if (level > 9 || level < 0) {
-		/* invalid level */
+	meminfo = checkparams(params, &hashbits);
+	if (meminfo == 0) {
 		return NULL;
 	}
+	flags = params->flags;
+	level = params->level;
 
 	if (allctr == NULL) {
 		allctr = ctb_getdefaultallocator();
@@ -394,23 +985,57 @@ deflator_create(uintxx flags, intxx level, const TAllocator* allctr)
 	}
 	PRVT->allctr = allctr;
 
-	PRVT->window = NULL;
-	PRVT->lzlist = NULL;
+	PRVT->window  = NULL;
+	PRVT->wbuffer = NULL;
+	PRVT->mirror  = 0;
+	PRVT->lzlist  = NULL;
+	PRVT->pipe    = NULL;
+
+	PRVT->hashbits = hashbits;
+	PRVT->meminfo  = meminfo;
 
 	PRVT->level = (int32) level;
-	if (allocatemem(PRVT, getmeminfo(level)) == 0) {
+	PBLC->flags = (uint32) flags;
+	if (allocatemem(PRVT, meminfo) == 0) {
 		deflator_destroy(state);
 		return NULL;
 	}
 	setparameters(PRVT, level);
 
+	if (params->maxchain) {
+		PRVT->maxchain = params->maxchain;
+	}
+	if (params->nicelength) {
+		PRVT->nicelength = params->nicelength;
+	}
+	if (params->goodlength) {
+		PRVT->goodlength = params->goodlength;
+	}
+	if (params->lazy == DEFLT_PDISABLE) {
+		/* every match is taken as it's found */
+		PRVT->goodlength = MINMATCH;
+	}
+	PRVT->shortmode = params->shortmatches;
+	PRVT->gvtarget  = 0;
+#if defined(DEFLT_SIMDMATCH)
+	setmatchlength(PRVT);
+#endif
+
+	/* nothing is initialized yet */
+	PRVT->dirty = 1;
+
+#if defined(JDEFLATE_THREADS)
+	if ((flags & DEFLT_PIPELINE) && level) {
+		/* without the thread the blocks are encoded as usual */
+		createpipe(PRVT, GETWNBFFSZ(meminfo), GETLZBFFSZ(meminfo));
+	}
+#endif
+
 	deflator_reset(state);
 	if (PBLC->error) {
 		deflator_destroy(state);
 		return NULL;
 	}
-
-	PBLC->flags = (uint32) flags;
 	return state;
 }
 
@@ -420,22 +1045,46 @@ resetcache(struct TDEFLTPrvt* state)
 	uintxx i;
 	uintxx j;
 
-	j = HMASK + 1;
+	if (PRVT->buckets) {
+		struct TDEFLTBucket* bucket;
+
+		j = BMASK + 1;
+		for (i = 0; j > i; i++) {
+			uintxx k;
+
+			bucket = PRVT->buckets + i;
+			for (k = 0; k < BUCKETSIZE; k++) {
+				bucket->positions[k] = (TPosition) -(WNDWSIZE);
+				bucket->checks[k] = 0;
+			}
+			bucket->head = 0;
+		}
+		return;
+	}
+
+	j = (uintxx) 1 << PRVT->hashbits;
 	for (i = 0; j > i; i++) {
-		PRVT->mhlist[i] = (int16) -(WNDWSIZE);
+		PRVT->mhlist[i] = (TPosition) -(WNDWSIZE);
 	}
 	j = CMASK + 1;
 	for (i = 0; j > i; i++) {
-		PRVT->mchain[i] = (int16) -(WNDWSIZE);
+		PRVT->mchain[i] = (TPosition) -(WNDWSIZE);
 	}
 
-	if (PRVT->level > 5) {
+	if (PRVT->shlist) {
 		j = QMASK + 1;
 		for (i = 0; j > i; i++) {
 			PRVT->shlist[i] = 0;
 			PRVT->schain[i] = 0;
 		}
 	}
+
+	if (PRVT->btree) {
+		j = (CMASK + 1) << 1;
+		for (i = 0; j > i; i++) {
+			PRVT->btree[i] = (TPosition) -(WNDWSIZE);
+		}
+	}
 }
 
 static void
@@ -451,6 +1100,8 @@ resetfreqs(struct TDEFLTPrvt* state)
 	}
 }
 
+static void rewindcache(struct TDEFLTPrvt*);
+
 void
 deflator_reset(TDeflator* state)
 {
@@ -486,47 +1137,108 @@ deflator_reset(TDeflator* state)
 
 	PRVT->bbuffer = 0;
 	PRVT->bcount  = 0;
+	PRVT->window  = PRVT->wbuffer;
+
+	/* the governor keeps its target and level */
+	PRVT->gvtime  = 0;
+	PRVT->gvinput = 0;
+
+	end = PRVT->windowend + WNDNGUARDSIZE;
 	if (PRVT->level) {
+		/* the window past the last input is still zero */
+		if (PRVT->dirty == 0 && PRVT->whence3 == 0) {
+			if ((uintxx) (end - PRVT->inputend) > WNDNGUARDSIZE) {
+				end = PRVT->inputend + WNDNGUARDSIZE;
+			}
+		}
+		rewindcache(PRVT);
+
 		PRVT->whence3 = 0;
-		PRVT->whence4 = 0;
 		PRVT->cursor  = 0;
+		PRVT->bstart  = 0;
+
+		PRVT->pbend    = PROBESIZE;
+		PRVT->pbmatch  = 0;
+		PRVT->rawmode  = 0;
+		PRVT->rawcount = 0;
 
 		PRVT->zend = PRVT->lzlist;
 		PRVT->zptr = PRVT->lzlist;
-		resetcache(PRVT);
+
+		if (PRVT->splitter) {
+			PRVT->splitter->mark = 0;
+			PRVT->splitter->tail = 0;
+		}
+
+#if defined(JDEFLATE_THREADS)
+		if (PRVT->pipe) {
+			resetpipe(PRVT);
+		}
+#endif
 	}
 
-	buffer = PRVT->window;
-	for (end = PRVT->windowend + WNDNGUARDSIZE; buffer < end;) {
+	for (buffer = PRVT->window; buffer < end;) {
 		*buffer++ = 0;
 	}
 	PRVT->inputend = PRVT->window;
+	PRVT->dirty = 0;
 }
 
 void
-deflator_destroy(TDeflator* state)
+deflator_settarget(TDeflator* state, uintxx speed)
 {
-	uintxx meminfo;
-	const struct TAllocator* a;
+	uint32 target;
+	CTB_ASSERT(state);
 
-	if (state == NULL) {
+	if ((PBLC->flags & DEFLT_GOVERNOR) == 0) {
+		return;
+	}
+	if (PRVT->level == 0 || PRVT->level > 7) {
 		return;
 	}
 
-	a = PRVT->allctr;
-	if (PRVT->level) {
-		uintxx n;
-
-		if (PRVT->level > 5) {
-			n = sizeof(struct TDEFLTPrvt2) + sizeof(struct TDEFLTExtra);
-		}
-		else {
-			n = sizeof(struct TDEFLTPrvt1) + sizeof(struct TDEFLTExtra);
+	target = 0;
+	if (speed && timer_now()) {
+		/* MB/s to nanoseconds per KiB */
+		target = (uint32) (1024000 / speed);
+		if (target == 0) {
+			target = 1;
 		}
+	}
+	if (target != PRVT->gvtarget) {
+		PRVT->gvtarget = target;
+		PRVT->gvtime  = 0;
+		PRVT->gvinput = 0;
+	}
+}
+
+void
+deflator_destroy(TDeflator* state)
+{
+	uintxx meminfo;
+	const struct TAllocator* a;
+
+	if (state == NULL) {
+		return;
+	}
+
+	a = PRVT->allctr;
+#if defined(JDEFLATE_THREADS)
+	if (PRVT->pipe) {
+		destroypipe(PRVT);
+	}
+#endif
+
+	if (PRVT->level) {
+		uintxx n;
+		intxx level;
+
+		level = getalloclevel(PBLC->flags, PRVT->level);
+		n = getextrasize(PBLC->flags, level, PRVT->hashbits);
 		a->dispose(PRVT->extra, n, a->user);
 	}
 
-	meminfo = getmeminfo(PRVT->level);
+	meminfo = PRVT->meminfo;
 	if (meminfo) {
 		uintxx sz1;
 		uintxx sz2;
@@ -537,8 +1249,14 @@ deflator_destroy(TDeflator* state)
 		if (PRVT->lzlist) {
 			a->dispose(PRVT->lzlist, sz2 * sizeof(PRVT->lzlist[0]), a->user);
 		}
-		if (PRVT->window) {
-			a->dispose(PRVT->window, sz1 * sizeof(PRVT->window[0]), a->user);
+		if (PRVT->wbuffer) {
+			if (PRVT->mirror) {
+				vmirror_destroy(PRVT->wbuffer, PRVT->mirror);
+			}
+			else {
+				a->dispose(
+					PRVT->wbuffer, sz1 * sizeof(PRVT->window[0]), a->user);
+			}
 		}
 	}
 	a->dispose(PRVT, sizeof(struct TDEFLTPrvt), a->user);
@@ -659,6 +1377,7 @@ static uint32 flushblock(struct TDEFLTPrvt*);
 static uint32 compress0(struct TDEFLTPrvt*);
 static uint32 compress1(struct TDEFLTPrvt*);
 static uint32 compress2(struct TDEFLTPrvt*);
+static uint32 compress3(struct TDEFLTPrvt*);
 
 CTB_INLINE bool
 validate(struct TDEFLTPrvt* state)
@@ -687,11 +1406,63 @@ validate(struct TDEFLTPrvt* state)
 	return 1;
 }
 
-eDEFLTResult
-deflator_deflate(TDeflator* state, eDEFLTFlush flush)
+/* Minimum input between two decisions of the governor */
+#define GVMININPUT 0x20000
+
+/* Moves the level one step at a block boundary when the throughput is not
+ * the target one */
+static void
+governor(struct TDEFLTPrvt* state)
+{
+	uint64 now;
+	uint64 cost;
+	uint64 target;
+	intxx level;
+
+	now = timer_now();
+	PRVT->gvtime  += now - PRVT->gvmark;
+	PRVT->gvinput += (uintxx) (PBLC->source - PRVT->gvsource);
+	PRVT->gvmark   = now;
+	PRVT->gvsource = PBLC->source;
+	if (PRVT->gvinput < GVMININPUT) {
+		return;
+	}
+
+	/* nanoseconds per KiB */
+	cost   = (PRVT->gvtime << 10) / PRVT->gvinput;
+	target = PRVT->gvtarget;
+
+	level = PRVT->level;
+	if (cost > target) {
+		if (level > 1) {
+			level--;
+		}
+	}
+	else {
+		if (cost < target - (target >> 2) && level < 7) {
+			level++;
+		}
+	}
+
+	if (level != PRVT->level) {
+		/* the greedy parser can't take the pending match of the lazy one,
+		 * we wait for the next block */
+		if (level == 5 && PRVT->aux5) {
+			return;
+		}
+		PRVT->level = (int32) level;
+		setparameters(PRVT, level);
+	}
+	PRVT->gvtime  = 0;
+	PRVT->gvinput = 0;
+}
+
+#undef GVMININPUT
+
+static eDEFLTResult
+rundeflate(TDeflator* state, eDEFLTFlush flush)
 {
 	uint32 r;
-	CTB_ASSERT(state);
 
 	if (CTB_EXPECT1(PBLC->state ^ 0xDEADBEEF)) {
 		if (flush && (PBLC->flush == 0 || PBLC->flush == DEFLT_FLUSH)) {
@@ -727,24 +1498,54 @@ deflator_deflate(TDeflator* state, eDEFLTFlush flush)
 					case 5:
 						r = compress1(PRVT);
 						break;
-					default:  /* 6 7 8 9 */
+					case 6:
+					case 7:
+					case 8:
+					case 9:
 						r = compress2(PRVT);
 						break;
+					default:  /* 10 11 12 */
+						r = compress3(PRVT);
+						break;
 				}
 
 				if (r) {
 					/* source exhausted */
+#if defined(JDEFLATE_THREADS)
+					if (PRVT->pipe) {
+						/* copy the blocks that are already encoded */
+						uint32 s;
+
+						s = drainpipe(PRVT, 2);
+						if (s) {
+							return (PBLC->status = s);
+						}
+					}
+#endif
 					return (PBLC->status = r);
 				}
 			}
 
 			/* fallthrough */
 			case 1: {
+#if defined(JDEFLATE_THREADS)
+				if (PRVT->pipe) {
+					r = queueblock(PRVT);
+				}
+				else {
+					r = flushblock(PRVT);
+				}
+#else
 				r = flushblock(PRVT);
+#endif
 				if (r) {
 					return (PBLC->status = r);
 				}
 
+				if (PRVT->gvtarget) {
+					governor(PRVT);
+				}
+
 				if (PBLC->flush) {
 					if (PRVT->hasinput == 0) {
 						SETSTATE(2);
@@ -756,15 +1557,25 @@ deflator_deflate(TDeflator* state, eDEFLTFlush flush)
 
 			/* end the stream */
 			case 2: {
+#if defined(JDEFLATE_THREADS)
+				if (PRVT->pipe) {
+					r = drainpipe(PRVT, 0);
+					if (r) {
+						return (PBLC->status = r);
+					}
+				}
+#endif
 				r = endstream(PRVT);
 				if (r) {
 					return (PBLC->status = DEFLT_TGTEXHSTD);
 				}
 				if (PBLC->flush == DEFLT_FLUSH) {
 					/* we don't invalidate the state here so we can continue
-					 * compressing using the same window */
+					 * compressing using the same window, the last positions
+					 * were hashed with the bytes past the input */
 					PBLC->state = 0;
 					PBLC->flush = 0;
+					PRVT->dirty = 1;
 				}
 				else {
 					SETSTATE(0xDEADBEEF);
@@ -785,6 +1596,92 @@ L_ERROR:
 	return DEFLT_ERROR;
 }
 
+eDEFLTResult
+deflator_deflate(TDeflator* state, eDEFLTFlush flush)
+{
+	eDEFLTResult r;
+	CTB_ASSERT(state);
+
+	if (PRVT->gvtarget == 0) {
+		return rundeflate(state, flush);
+	}
+
+	/* the governor only counts the time spent here */
+	PRVT->gvmark   = timer_now();
+	PRVT->gvsource = PBLC->source;
+	r = rundeflate(state, flush);
+	PRVT->gvtime  += timer_now() - PRVT->gvmark;
+	PRVT->gvinput += (uintxx) (PBLC->source - PRVT->gvsource);
+	return r;
+}
+
+
+/* Source bytes left out of the one-shot window, the match finders read past
+ * the end of the input */
+#define ONESHOTTAIL 1024
+
+uintxx
+deflator_compressbuffer(TDeflator* state, const uint8* source, uintxx size,
+	uint8* target, uintxx tsize)
+{
+	eDEFLTResult r;
+	CTB_ASSERT(state && target && tsize);
+
+	deflator_reset(state);
+	if (size == 0) {
+		/* an empty final block */
+		deflator_settgt(state, target, tsize);
+		PBLC->source = PBLC->sbgn = PBLC->send = target;
+		r = deflator_deflate(state, DEFLT_END);
+		goto L_DONE;
+	}
+
+	if (PRVT->level == 0 || size <= (ONESHOTTAIL << 1)) {
+		deflator_setsrc(state, source, size);
+		deflator_settgt(state, target, tsize);
+		r = deflator_deflate(state, DEFLT_END);
+		goto L_DONE;
+	}
+
+	/* the match finders run over the source buffer, fillwindow moves the
+	 * last part to the window buffer */
+	PRVT->window   = CTB_CONSTCAST(source);
+	PRVT->inputend = PRVT->window + (size - ONESHOTTAIL);
+	deflator_setsrc(state, source + (size - ONESHOTTAIL), ONESHOTTAIL);
+	deflator_settgt(state, target, tsize);
+	r = deflator_deflate(state, DEFLT_END);
+	if (PRVT->window != PRVT->wbuffer) {
+		/* the input is not in the window buffer */
+		PRVT->window = PRVT->wbuffer;
+		PRVT->dirty  = 1;
+	}
+
+#if defined(JDEFLATE_THREADS)
+	if (PRVT->pipe) {
+		/* the pending jobs can use the source buffer */
+		resetpipe(PRVT);
+	}
+#endif
+
+L_DONE:
+	if (r != DEFLT_OK) {
+		return 0;
+	}
+	return deflator_tgtend(state);
+}
+
+#undef ONESHOTTAIL
+
+uintxx
+deflator_compressbound(uintxx size)
+{
+	/* the worst case is a static block of 9 bit literals, dynamic blocks
+	 * are not larger than that plus its header (at most 286 bytes for a
+	 * block of 7168 bytes or more), plus the last block and the end of
+	 * the stream */
+	return size + (size >> 3) + (size >> 4) + 512;
+}
+
 /* block types */
 #define BLOCKSTRD 0
 #define BLOCKSTTC 1
@@ -1391,6 +2288,63 @@ buildtables(struct TDEFLTExtra* extra)
 
 #define BLOCKENDSYMBOL 256
 
+/* Number of bits used by the trees in the run length encoded form */
+static uintxx
+treebits(const struct TDEFLTExtra* e, const uintxx* slist)
+{
+	uintxx total;
+	uintxx symbol;
+
+	total = 0;
+	while ((symbol = *slist++) ^ 0xffff) {
+		total += e->precodes[symbol].length;
+		if (symbol > 15) {
+			switch (symbol) {
+				case 16: total += 2; break;
+				case 17: total += 3; break;
+				default: total += 7; break;
+			}
+			slist++;
+		}
+	}
+	return total;
+}
+
+/* Number of bits a dynamic block with the given frequencies would use, the
+ * extra bits of the lengths and distances are not included (they are the
+ * same for any split), the extra frequencies are overwritten */
+static uintxx
+dynamicbits(struct TDEFLTExtra* e, const uintxx* lfrqs, const uintxx* dfrqs)
+{
+	uintxx i;
+	uintxx total;
+
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		e->lfrqs[i] = lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		e->dfrqs[i] = dfrqs[i];
+	}
+	e->lfrqs[BLOCKENDSYMBOL]++;
+	buildtables(e);
+
+	/* block header, tree sizes and precodes */
+	total = 3 + 14 + (e->cmax * 3);
+	total += treebits(e, e->lfrqs) + treebits(e, e->dfrqs);
+
+	total += e->litcodes[BLOCKENDSYMBOL].length;
+	for (i = 0; MAXLTCODES > i; i++) {
+		total += lfrqs[i] * e->litcodes[i].length;
+	}
+	for (; DEFLT_LMAXSYMBOL > i; i++) {
+		total += lfrqs[i] * e->lnscodes[i - MAXLTCODES].length;
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		total += dfrqs[i] * e->dstcodes[i].length;
+	}
+	return total;
+}
+
 
 /* write N bytes from B (bit buffer) to T (target buffer) */
 #define W1(T, B) *(T)++ = (uint8) (B); (B) = (B) >> 8;
@@ -1402,40 +2356,68 @@ buildtables(struct TDEFLTExtra* extra)
 
 #if defined(CTB_ENV64)
 
+#if !defined(CTB_STRICTALIGNMENT) && defined(CTB_FASTUNALIGNED)
+
+/* stores the whole bit buffer and keeps only the bits of the last incomplete
+ * byte, the caller must ensure there are at least 8 bytes in the target */
+#define WWORD(T, B, C) \
+	*((uint64*) (T)) = CTB_SWAP64ONBE(B); \
+	(T) += (C) >> 3; (B) >>= (C) & 0x38; (C) &= 7;
+
+/* after a word store there are at most 7 bits in the buffer, there is room
+ * for a whole match (48 bits) so the distance does not need a check */
 #define ENSURE2ON32(T, B, C)
+#define ENSURE3ON32(T, B, C)
+#define ENSURE2ON64(T, B, C) WWORD(T, B, C)
+#define ENSURE3ON64(T, B, C) WWORD(T, B, C)
+#define ENSURE4ON64(T, B, C)
+
+#else
+
+#define ENSURE2ON32(T, B, C)
+#define ENSURE3ON32(T, B, C)
 #define ENSURE2ON64(T, B, C) if (CTB_EXPECT1(C > 48)) { W6(T, B); C -= 48; }
 #define ENSURE3ON64(T, B, C) if (CTB_EXPECT1(C > 40)) { W5(T, B); C -= 40; }
 #define ENSURE4ON64(T, B, C) if (CTB_EXPECT1(C > 32)) { W4(T, B); C -= 32; }
 
+#endif
+
 #else
 
 #define ENSURE2ON64(T, B, C)
 #define ENSURE3ON64(T, B, C)
 #define ENSURE4ON64(T, B, C)
 #define ENSURE2ON32(T, B, C) if (CTB_EXPECT1(C > 16)) { W2(T, B); C -= 16; }
+#define ENSURE3ON32(T, B, C) \
+	ENSURE2ON32(T, B, C); if (C > 8) { W1(T, B); C -= 8; }
 
 #endif
 
 #define EMIT(BB, BC, BITS, N) BB |= (bitbuffer) (BITS) << (BC); BC += (N);
 
+#if defined(__clang__) && defined(CTB_FASTUNALIGNED)
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wcast-align"
+#endif
+
 static uint32
 emitlzfast(struct TDEFLTPrvt* state)
 {
 	bitbuffer bb;
 	uintxx bc;
 	uint32 r;
-	uintxx extra;
 	uint8* target;
 	const struct THCode1* littable;
-	const struct THCode2* lnstable;
+	const struct THCode3* lentable;
 	const struct THCode2* dsttable;
 	struct THCode1 code1;
-	struct THCode2 lcode;
+	struct THCode3 lcode;
 	struct THCode2 dcode;
-	uint16* lzlist;
+	uint32 token;
+	uint32* lzlist;
 
 	littable = PRVT->extra->littable;
-	lnstable = PRVT->extra->lnstable;
+	lentable = PRVT->extra->lencodes;
 	dsttable = PRVT->extra->dsttable;
 
 	/* load the state */
@@ -1444,51 +2426,46 @@ emitlzfast(struct TDEFLTPrvt* state)
 	lzlist = PRVT->zptr;
 	target = PBLC->target;
 
+	/* tryemitbits can leave the buffer full, a full shift is undefined */
+	if (bc == (sizeof(bitbuffer) << 3)) {
+		W1(target, bb);
+		bc -= 8;
+	}
+
 	r = 1;
 	while ((uintxx) (PBLC->tend - target) >= (8 + (sizeof(bitbuffer) << 1))) {
-		if (CTB_EXPECT1(lzlist[0] < 0x8000)) {
-			code1 = littable[lzlist[0]];
+		token = *lzlist++;
+		if (CTB_EXPECT1(token < 0x200)) {
+			code1 = littable[token];
 
 			/* 15 */
 			ENSURE2ON64(target, bb, bc);
 			ENSURE2ON32(target, bb, bc);
 			EMIT(bb, bc, code1.code, code1.length);
 
-			if (CTB_EXPECT0(lzlist[0] == BLOCKENDSYMBOL)) {
+			if (CTB_EXPECT0(token == BLOCKENDSYMBOL)) {
+				lzlist--;
 				r = 0;
 				goto L_DONE;
 			}
-			lzlist++;
 			continue;
 		}
 
-		lcode = lnstable[(uint8) (lzlist[2] >> 0x08)];
-		dcode = dsttable[(uint8) (lzlist[2] >> 0x00)];
+		lcode = lentable[token & 0xff];
+		dcode = dsttable[(token >> 0x0a) & 0x1f];
 
-		/* length 15 + 5 */
+		/* length 15 + 5 (code and extra bits together) */
 		ENSURE3ON64(target, bb, bc);
-		ENSURE2ON32(target, bb, bc);
+		ENSURE3ON32(target, bb, bc);
 		EMIT(bb, bc, lcode.code, lcode.length);
 
-		if (CTB_EXPECT1(lcode.extra)) {
-			extra = (lzlist[0] - (uintxx) (0x8000)) - lcode.base;
-
-			ENSURE2ON32(target, bb, bc);
-			EMIT(bb, bc, extra, lcode.extra);
-		}
-
-		/* distance 15 + 13 */
+		/* distance 15 + 13, the extra value is zero when there are no
+		 * extra bits so we can emit it unconditionally */
 		ENSURE4ON64(target, bb, bc);
 		ENSURE2ON32(target, bb, bc);
 		EMIT(bb, bc, dcode.code, dcode.length);
-
-		if (dcode.extra) {
-			extra = lzlist[1] - dcode.base;
-
-			ENSURE2ON32(target, bb, bc);
-			EMIT(bb, bc, extra, dcode.extra);
-		}
-		lzlist += 3;
+		ENSURE2ON32(target, bb, bc);
+		EMIT(bb, bc, token >> 0x0f, dcode.extra);
 	}
 
 L_DONE:
@@ -1500,12 +2477,17 @@ L_DONE:
 	return r;
 }
 
+#if defined(__clang__) && defined(CTB_FASTUNALIGNED)
+	#pragma clang diagnostic pop
+#endif
+
 #undef W1
 #undef W2
 #undef W3
 #undef W4
 #undef W5
 #undef W6
+#undef WWORD
 #undef EMIT
 
 static uint32
@@ -1515,13 +2497,14 @@ emitlz(struct TDEFLTPrvt* state)
 	uint32 r;
 	uint32 fastcheck;
 	const struct THCode1* littable;
-	const struct THCode2* lnstable;
+	const struct THCode3* lentable;
 	const struct THCode2* dsttable;
 	struct THCode1 code1;
 	struct THCode2 code2;
+	struct THCode3 code3;
 
 	littable = PRVT->extra->littable;
-	lnstable = PRVT->extra->lnstable;
+	lentable = PRVT->extra->lencodes;
 	dsttable = PRVT->extra->dsttable;
 
 	fastcheck = 1;
@@ -1547,7 +2530,7 @@ L_LOOP:
 		goto L_LOOP;
 	}
 
-	if (PRVT->zptr[0] < 0x8000) {
+	if (PRVT->zptr[0] < 0x200) {
 		code1 = littable[PRVT->zptr[0]];
 		if (tryemitbits(PRVT, code1.length)) {
 			putbits(PRVT, code1.code, code1.length);
@@ -1567,34 +2550,18 @@ L_LOOP:
 
 L_STATE1:
 	/* length */
-	code2 = lnstable[(uint8) (PRVT->zptr[2] >> 0x08)];
-	if (PRVT->aux2 == 0) {
-		if (tryemitbits(PRVT, code2.length)) {
-			putbits(PRVT, code2.code, code2.length);
-		}
-		else {
-			PRVT->aux1 = 1;
-			PRVT->aux2 = 0;
-			return 1;
-		}
+	code3 = lentable[PRVT->zptr[0] & 0xff];
+	if (tryemitbits(PRVT, code3.length)) {
+		putbits(PRVT, code3.code, code3.length);
 	}
-
-	if (code2.extra) {
-		extra = ((uintxx) PRVT->zptr[0] - 0x8000) - code2.base;
-		if (tryemitbits(PRVT, code2.extra)) {
-			putbits(PRVT, extra, code2.extra);
-		}
-		else {
-			PRVT->aux1 = 1;
-			PRVT->aux2 = 1;
-			return 1;
-		}
-		PRVT->aux2 = 0;
+	else {
+		PRVT->aux1 = 1;
+		return 1;
 	}
 
 L_STATE2:
 	/* distance */
-	code2 = dsttable[(uint8) (PRVT->zptr[2] >> 0x00)];
+	code2 = dsttable[(PRVT->zptr[0] >> 0x0a) & 0x1f];
 	if (PRVT->aux2 == 0) {
 		if (tryemitbits(PRVT, code2.length)) {
 			putbits(PRVT, code2.code, code2.length);
@@ -1607,7 +2574,7 @@ L_STATE2:
 	}
 
 	if (code2.extra) {
-		extra = PRVT->zptr[1] - code2.base;
+		extra = PRVT->zptr[0] >> 0x0f;
 		if (tryemitbits(PRVT, code2.extra)) {
 			putbits(PRVT, extra, code2.extra);
 		}
@@ -1619,7 +2586,7 @@ L_STATE2:
 		PRVT->aux2 = 0;
 	}
 
-	PRVT->zptr += 3;
+	PRVT->zptr++;
 	goto L_LOOP;
 
 L_DONE:
@@ -1721,12 +2688,147 @@ L_STATE2:
 	return 0;
 }
 
+/* Sets the length codes with their extra bits from lnstable */
+static void
+setlentable(struct TDEFLTExtra* e)
+{
+	uintxx i;
+	uintxx j;
+	uintxx n;
+	struct THCode2 code;
+	struct THCode3* lencodes;
+
+	/* symbols 257 to 284, the last extra value of 284 would be length 258
+	 * but it has its own symbol */
+	for (i = 0; i < 28; i++) {
+		code = e->lnstable[i];
+
+		lencodes = e->lencodes + (code.base - 3);
+		n = (uintxx) 1 << code.extra;
+		for (j = 0; j < n && code.base + j < 258; j++) {
+			lencodes[j].length = (uint8) (code.length + code.extra);
+			lencodes[j].code = (uint32) (code.code | (j << code.length));
+		}
+	}
+
+	/* symbol 285, length 258 without extra bits */
+	code = e->lnstable[28];
+	e->lencodes[258 - 3].length = (uint8) code.length;
+	e->lencodes[258 - 3].code = (uint32) code.code;
+}
+
+/* Number of bytes of the block (the token list must be ended) */
+static uintxx
+blocklength(const uint32* lzlist)
+{
+	uintxx total;
+	uint32 token;
+
+	total = 0;
+	for (;;) {
+		token = *lzlist++;
+		if (token < 0x200) {
+			if (token == BLOCKENDSYMBOL) {
+				break;
+			}
+			total++;
+			continue;
+		}
+		total += (token & 0xff) + 3;
+	}
+	return total;
+}
+
+/* Checks if the bytes of the block are still in the window */
+CTB_INLINE bool
+canstore(struct TDEFLTPrvt* state)
+{
+	uintxx used;
+
+	used = (uintxx) (PRVT->inputend - PRVT->window);
+	if (PRVT->bstart <= used) {
+		if (PRVT->mirror == 0 || used - PRVT->bstart <= PRVT->mirror) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Selects the block type that takes less bits, when the block is dynamic the
+ * tables are built */
+static uintxx
+selectblock(struct TDEFLTPrvt* state, uintxx length)
+{
+	uintxx i;
+	uintxx n;
+	uintxx extra;
+	uintxx sttcbits;
+	uintxx strdbits;
+	uintxx dnmcbits;
+	uintxx btype;
+	uintxx lfrqs[DEFLT_LMAXSYMBOL];
+	uintxx dfrqs[DEFLT_DMAXSYMBOL];
+	struct TDEFLTExtra* e;
+
+	e = PRVT->extra;
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		lfrqs[i] = e->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		dfrqs[i] = e->dfrqs[i];
+	}
+
+	/* the extra bits are the same for the static and dynamic blocks */
+	extra = 0;
+	sttcbits = 3 + slitcodes[BLOCKENDSYMBOL].length;
+	for (i = 0; MAXLTCODES > i; i++) {
+		sttcbits += lfrqs[i] * slitcodes[i].length;
+	}
+	for (; DEFLT_LMAXSYMBOL > i; i++) {
+		sttcbits += lfrqs[i] * slnscodes[i - MAXLTCODES].length;
+		extra    += lfrqs[i] * slnscodes[i - MAXLTCODES].extra;
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		sttcbits += dfrqs[i] * sdstcodes[i].length;
+		extra    += dfrqs[i] * sdstcodes[i].extra;
+	}
+	sttcbits += extra;
+	btype = BLOCKSTTC;
+
+	/* the stored block is only possible if the bytes are still in the
+	 * window */
+	strdbits = (uintxx) -1;
+	if (canstore(PRVT)) {
+		/* the first header is padded from the current bit position, the
+		 * next ones take a byte */
+		n = (length + (MAXSTRDSIZE - 1)) / MAXSTRDSIZE;
+		strdbits  = 3 + ((8 - ((PRVT->bcount + 3) & 7)) & 7);
+		strdbits += ((n - 1) << 3) + (n << 5) + (length << 3);
+	}
+
+	if ((PBLC->flags & DEFLT_FIXEDCODES) || PRVT->level == 1) {
+		dnmcbits = (uintxx) -1;
+	}
+	else {
+		dnmcbits = dynamicbits(e, lfrqs, dfrqs) + extra;
+	}
+
+	if (dnmcbits < sttcbits) {
+		sttcbits = dnmcbits;
+		btype = BLOCKDNMC;
+	}
+	if (strdbits < sttcbits) {
+		btype = BLOCKSTRD;
+	}
+	return btype;
+}
+
 static uint32
 flushblock(struct TDEFLTPrvt* state)
 {
 	uintxx total;
+	uintxx length;
 	uint32 r;
-	bool dostatic;
 
 	switch (PRVT->substate) {
 		case 0:
@@ -1734,6 +2836,10 @@ flushblock(struct TDEFLTPrvt* state)
 		case 1: goto L_STATE1;
 		case 2: goto L_STATE2;
 		case 3: goto L_STATE3;
+		case 4: goto L_STATE4;
+		case 5: goto L_STATE5;
+		case 6: goto L_STATE6;
+		case 7: goto L_STATE7;
 	}
 
 	total = (uintxx) (PRVT->zend - PRVT->zptr);
@@ -1745,31 +2851,39 @@ flushblock(struct TDEFLTPrvt* state)
 	}
 
 	/* append the end-of-block symbol */
-	PRVT->extra->lfrqs[BLOCKENDSYMBOL]++;
 	PRVT->zend[0] = BLOCKENDSYMBOL;
 	PRVT->zend++;
 
-	dostatic = (PRVT->level == 1) || (PBLC->flags & DEFLT_FIXEDCODES);
+	length = blocklength(PRVT->zptr);
+	PRVT->blocktype = (uint32) selectblock(PRVT, length);
+	if (PRVT->blocktype == BLOCKSTRD) {
+		PRVT->zptr = PRVT->lzlist;
+		PRVT->zend = PRVT->lzlist;
 
-	/* force an static block for small blocks */
-	if (dostatic == 1 || total < 0x400) {
-		PRVT->blocktype = BLOCKSTTC;
-	}
-	else {
-		PRVT->blocktype = BLOCKDNMC;
+		/* aux1 is the size of the current stored block and aux2 the number
+		 * of bytes left after it */
+		PRVT->aux1 = length;
+		PRVT->aux2 = 0;
+		if (length > MAXSTRDSIZE) {
+			PRVT->aux1 = MAXSTRDSIZE;
+			PRVT->aux2 = length - MAXSTRDSIZE;
+		}
+		goto L_STATE4;
 	}
+	PRVT->bstart += length;
 
 	if (PRVT->blocktype == BLOCKDNMC) {
+		/* the tables were built by selectblock */
 		PRVT->extra->littable = PRVT->extra->litcodes;
 		PRVT->extra->lnstable = PRVT->extra->lnscodes;
 		PRVT->extra->dsttable = PRVT->extra->dstcodes;
-		buildtables(PRVT->extra);
 	}
 	else {
 		PRVT->extra->littable = (const void*) slitcodes;
 		PRVT->extra->lnstable = (const void*) slnscodes;
 		PRVT->extra->dsttable = (const void*) sdstcodes;
 	}
+	setlentable(PRVT->extra);
 
 L_STATE1:
 	/* block header */
@@ -1797,19 +2911,479 @@ L_STATE3:
 		PRVT->substate = 3;
 		return DEFLT_TGTEXHSTD;
 	}
+	goto L_DONE;
 
-	SETSTATE(0);
-	PRVT->substate  = 0;
-	PRVT->blockinit = 0;
-	return 0;
-}
-
+L_STATE4:
+	/* stored block header, aligned to the byte boundary */
+	if (tryemitbits(PRVT, 3 + 7)) {
+		putbits(PRVT, 0, 1);
+		putbits(PRVT, BLOCKSTRD, 2);
+		putbits(PRVT, 0, (8 - (PRVT->bcount & 7)) & 7);
+	}
+	else {
+		PRVT->substate = 4;
+		return DEFLT_TGTEXHSTD;
+	}
 
-/* ***************************************************************************
- * Mathfinder related code
- *************************************************************************** */
+L_STATE5:
+	if (tryemitbits(PRVT, 16)) {
+		putbits(PRVT, (uint16)  PRVT->aux1, 16);
+	}
+	else {
+		PRVT->substate = 5;
+		return DEFLT_TGTEXHSTD;
+	}
 
-#if defined(__clang__)
+L_STATE6:
+	if (tryemitbits(PRVT, 16)) {
+		putbits(PRVT, (uint16) ~PRVT->aux1, 16);
+	}
+	else {
+		PRVT->substate = 6;
+		return DEFLT_TGTEXHSTD;
+	}
+
+L_STATE7:
+	if (tryflushbits(PRVT) == 0) {
+		PRVT->substate = 7;
+		return DEFLT_TGTEXHSTD;
+	}
+	else {
+		uintxx maxrun;
+
+		maxrun = (uintxx) (PBLC->tend - PBLC->target);
+		if (maxrun > PRVT->aux1) {
+			maxrun = PRVT->aux1;
+		}
+		ctb_memcpy(PBLC->target, PRVT->window + PRVT->bstart, maxrun);
+		PBLC->target += maxrun;
+		PRVT->bstart += maxrun;
+
+		PRVT->aux1 -= maxrun;
+		if (PRVT->aux1) {
+			PRVT->substate = 7;
+			return DEFLT_TGTEXHSTD;
+		}
+	}
+
+	if (PRVT->aux2) {
+		PRVT->aux1 = PRVT->aux2;
+		PRVT->aux2 = 0;
+		if (PRVT->aux1 > MAXSTRDSIZE) {
+			PRVT->aux2 = PRVT->aux1 - MAXSTRDSIZE;
+			PRVT->aux1 = MAXSTRDSIZE;
+		}
+		goto L_STATE4;
+	}
+
+L_DONE:
+	SETSTATE(0);
+	PRVT->substate  = 0;
+	PRVT->blockinit = 0;
+	return 0;
+}
+
+
+/* ***************************************************************************
+ * Pipelined mode (DEFLT_PIPELINE)
+ *************************************************************************** */
+
+#if defined(JDEFLATE_THREADS)
+
+/* job states */
+#define PJOBFREE   0
+#define PJOBQUEUED 1
+#define PJOBDONE   2
+
+
+static void
+freejobs(struct TDEFLTPipe* pipe, const struct TAllocator* a)
+{
+	uintxx i;
+
+	for (i = 0; i < 2; i++) {
+		struct TDEFLTJob* job;
+
+		job = pipe->jobs + i;
+		if (job->tokens) {
+			a->dispose(job->tokens, pipe->tsize * sizeof(uint32), a->user);
+		}
+		if (job->sbuffer) {
+			a->dispose(job->sbuffer, pipe->wsize, a->user);
+		}
+		if (job->output) {
+			a->dispose(job->output, job->ocapacity, a->user);
+		}
+	}
+	a->dispose(pipe, sizeof(struct TDEFLTPipe), a->user);
+}
+
+/* Encodes the block of the job using the encoder state */
+static void
+encodejob(struct TDEFLTPipe* pipe, struct TDEFLTJob* job)
+{
+	uintxx i;
+	uint32 r;
+	struct TDEFLTPrvt* state;
+
+	state = &pipe->encoder;
+	PRVT->level = job->level;
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		PRVT->extra->lfrqs[i] = job->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		PRVT->extra->dfrqs[i] = job->dfrqs[i];
+	}
+	PRVT->lzlist = job->tokens;
+	PRVT->zptr   = job->tokens;
+	PRVT->zend   = job->tokens + job->ntokens;
+
+	/* the window is just the block, a block start past the end of the
+	 * window makes selectblock skip the stored type */
+	PRVT->window   = CTB_CONSTCAST(job->stored);
+	PRVT->inputend = PRVT->window + job->slength;
+	PRVT->bstart   = job->slength ? 0 : 1;
+
+	PBLC->target = job->output;
+	PBLC->tend   = job->output + job->ocapacity;
+	for (;;) {
+		uint8* buffer;
+		const struct TAllocator* a;
+
+		r = flushblock(PRVT);
+		job->osize = (uintxx) (PBLC->target - job->output);
+		if (r == 0) {
+			break;
+		}
+
+		/* the block is never larger than the static one so this should not
+		 * happen */
+		a = PRVT->allctr;
+		buffer = a->request(job->ocapacity << 1, a->user);
+		if (buffer == NULL) {
+			PRVT->substate = 0;
+			job->error = DEFLT_EOOM;
+			return;
+		}
+		ctb_memcpy(buffer, job->output, job->osize);
+		a->dispose(job->output, job->ocapacity, a->user);
+
+		job->output = buffer;
+		job->ocapacity <<= 1;
+		PBLC->target = job->output + job->osize;
+		PBLC->tend   = job->output + job->ocapacity;
+	}
+	job->ohead = 0;
+}
+
+THREADPROC(pipeloop)
+{
+	struct TDEFLTPipe* pipe;
+	struct TDEFLTJob* job;
+
+	pipe = argument;
+
+	mutex_lock(&pipe->mutex);
+	for (;;) {
+		while (pipe->quit == 0 && pipe->nqueued == 0) {
+			cond_wait(&pipe->work, &pipe->mutex);
+		}
+		if (pipe->quit) {
+			break;
+		}
+
+		job = pipe->jobs + pipe->next;
+		pipe->next = (pipe->next + 1) & 1;
+		pipe->nqueued--;
+		mutex_unlock(&pipe->mutex);
+
+		encodejob(pipe, job);
+
+		mutex_lock(&pipe->mutex);
+		job->state = PJOBDONE;
+		cond_signal(&pipe->done);
+	}
+	mutex_unlock(&pipe->mutex);
+
+	THREADRETURN;
+}
+
+static bool
+createpipe(struct TDEFLTPrvt* state, uintxx wsize, uintxx tsize)
+{
+	uintxx i;
+	struct TDEFLTPipe* pipe;
+	struct TDEFLTPrvt* encoder;
+	const struct TAllocator* a;
+
+	a = PRVT->allctr;
+	pipe = a->request(sizeof(struct TDEFLTPipe), a->user);
+	if (pipe == NULL) {
+		return 0;
+	}
+	pipe->tsize = tsize;
+	pipe->wsize = wsize;
+
+	for (i = 0; i < 2; i++) {
+		struct TDEFLTJob* job;
+
+		/* the selected block type is never larger than the static one (31
+		 * bits at most for each token) */
+		job = pipe->jobs + i;
+		job->ocapacity = (tsize << 2) + 1024;
+		job->tokens  = a->request(tsize * sizeof(uint32), a->user);
+		job->sbuffer = a->request(wsize, a->user);
+		job->output  = a->request(job->ocapacity, a->user);
+	}
+	for (i = 0; i < 2; i++) {
+		struct TDEFLTJob* job;
+
+		job = pipe->jobs + i;
+		if (job->tokens == NULL || job->sbuffer == NULL || job->output == NULL) {
+			goto L_ERROR1;
+		}
+	}
+
+	encoder = &pipe->encoder;
+	encoder->allctr = PRVT->allctr;
+	encoder->level  = PRVT->level;
+	encoder->mirror = 0;
+	encoder->extra  = &pipe->extra;
+	encoder->public.flags = PBLC->flags;
+	for (i = 0; i < MAXLZCODES; i++) {
+		pipe->extra.lnscodes[i] = slnscodes[i];
+		pipe->extra.dstcodes[i] = sdstcodes[i];
+	}
+
+	if (mutex_init(&pipe->mutex) == 0) {
+		goto L_ERROR1;
+	}
+	if (cond_init(&pipe->work) == 0) {
+		goto L_ERROR2;
+	}
+	if (cond_init(&pipe->done) == 0) {
+		goto L_ERROR3;
+	}
+
+	PRVT->pipe = pipe;
+	pipe->jobs[0].state = PJOBFREE;
+	pipe->jobs[1].state = PJOBFREE;
+	pipe->quit = 0;
+	resetpipe(PRVT);
+	if (thread_create(&pipe->thread, pipeloop, pipe) == 0) {
+		PRVT->pipe = NULL;
+		goto L_ERROR4;
+	}
+	return 1;
+
+L_ERROR4:
+	cond_destroy(&pipe->done);
+L_ERROR3:
+	cond_destroy(&pipe->work);
+L_ERROR2:
+	mutex_destroy(&pipe->mutex);
+L_ERROR1:
+	freejobs(pipe, a);
+	return 0;
+}
+
+static void
+destroypipe(struct TDEFLTPrvt* state)
+{
+	struct TDEFLTPipe* pipe;
+
+	pipe = PRVT->pipe;
+	mutex_lock(&pipe->mutex);
+	pipe->quit = 1;
+	cond_signal(&pipe->work);
+	mutex_unlock(&pipe->mutex);
+
+	thread_join(&pipe->thread);
+	cond_destroy(&pipe->done);
+	cond_destroy(&pipe->work);
+	mutex_destroy(&pipe->mutex);
+
+	freejobs(pipe, PRVT->allctr);
+	PRVT->pipe = NULL;
+}
+
+/* Waits for the queued jobs and drops all of them */
+static void
+resetpipe(struct TDEFLTPrvt* state)
+{
+	uintxx i;
+	struct TDEFLTPipe* pipe;
+
+	pipe = PRVT->pipe;
+	mutex_lock(&pipe->mutex);
+	for (i = 0; i < 2; i++) {
+		while (pipe->jobs[i].state == PJOBQUEUED) {
+			cond_wait(&pipe->done, &pipe->mutex);
+		}
+	}
+
+	for (i = 0; i < 2; i++) {
+		pipe->jobs[i].state = PJOBFREE;
+		pipe->jobs[i].error = 0;
+	}
+	pipe->head     = 0;
+	pipe->npending = 0;
+	pipe->next     = 0;
+	pipe->nqueued  = 0;
+	mutex_unlock(&pipe->mutex);
+
+	pipe->encoder.substate = 0;
+	pipe->encoder.aux1 = 0;
+	pipe->encoder.aux2 = 0;
+	pipe->encoder.bbuffer  = 0;
+	pipe->encoder.bcount   = 0;
+}
+
+/* Hands the block to the encoder thread, the state is left as flushblock
+ * leaves it */
+static uint32
+queueblock(struct TDEFLTPrvt* state)
+{
+	uintxx i;
+	uintxx total;
+	uintxx length;
+	uint32 r;
+	struct TDEFLTPipe* pipe;
+	struct TDEFLTJob* job;
+
+	pipe = PRVT->pipe;
+
+	total = (uintxx) (PRVT->zend - PRVT->zptr);
+	if (total == 0) {
+		goto L_DONE;
+	}
+
+	/* we need a free job */
+	r = drainpipe(PRVT, 1);
+	if (r) {
+		return r;
+	}
+	job = pipe->jobs + ((pipe->head + pipe->npending) & 1);
+
+	ctb_memcpy(job->tokens, PRVT->zptr, total * sizeof(PRVT->zptr[0]));
+	job->ntokens = total;
+	job->level   = PRVT->level;
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		job->lfrqs[i] = PRVT->extra->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		job->dfrqs[i] = PRVT->extra->dfrqs[i];
+	}
+
+	PRVT->zend[0] = BLOCKENDSYMBOL;
+	length = blocklength(PRVT->zptr);
+
+	/* the bytes must be copied now, the window changes while the block is
+	 * being encoded (the one-shot source does not) */
+	job->stored  = job->sbuffer;
+	job->slength = 0;
+	if (canstore(PRVT)) {
+		if (PRVT->window == PRVT->wbuffer) {
+			ctb_memcpy(job->sbuffer, PRVT->window + PRVT->bstart, length);
+		}
+		else {
+			job->stored = PRVT->window + PRVT->bstart;
+		}
+		job->slength = length;
+	}
+	PRVT->bstart += length;
+
+	PRVT->zptr = PRVT->lzlist;
+	PRVT->zend = PRVT->lzlist;
+
+	mutex_lock(&pipe->mutex);
+	if (pipe->npending == 0) {
+		/* the thread is idle, the stream continues from our bit buffer */
+		pipe->encoder.bbuffer = PRVT->bbuffer;
+		pipe->encoder.bcount  = PRVT->bcount;
+	}
+	job->state = PJOBQUEUED;
+	pipe->npending++;
+	pipe->nqueued++;
+	cond_signal(&pipe->work);
+	mutex_unlock(&pipe->mutex);
+
+L_DONE:
+	SETSTATE(0);
+	PRVT->substate  = 0;
+	PRVT->blockinit = 0;
+	return 0;
+}
+
+/* Copies the output of the encoded blocks to the target, it waits for the
+ * blocks until there are no more than keep of them pending */
+static uint32
+drainpipe(struct TDEFLTPrvt* state, uintxx keep)
+{
+	uintxx n;
+	uintxx maxrun;
+	uint32 done;
+	struct TDEFLTPipe* pipe;
+	struct TDEFLTJob* job;
+
+	pipe = PRVT->pipe;
+	while (pipe->npending) {
+		job = pipe->jobs + pipe->head;
+
+		mutex_lock(&pipe->mutex);
+		if (pipe->npending > keep) {
+			while (job->state != PJOBDONE) {
+				cond_wait(&pipe->done, &pipe->mutex);
+			}
+		}
+		done = job->state == PJOBDONE;
+		mutex_unlock(&pipe->mutex);
+		if (done == 0) {
+			break;
+		}
+
+		if (job->error) {
+			SETERROR(job->error);
+			SETSTATE(0xDEADBEEF);
+			return DEFLT_ERROR;
+		}
+
+		n = job->osize - job->ohead;
+		maxrun = (uintxx) (PBLC->tend - PBLC->target);
+		if (n > maxrun) {
+			n = maxrun;
+		}
+		ctb_memcpy(PBLC->target, job->output + job->ohead, n);
+		PBLC->target += n;
+		job->ohead   += n;
+		if (job->ohead != job->osize) {
+			return DEFLT_TGTEXHSTD;
+		}
+
+		job->state = PJOBFREE;
+		pipe->head = (pipe->head + 1) & 1;
+		pipe->npending--;
+		if (pipe->npending == 0) {
+			/* the thread is idle, the bit buffer is ours again */
+			PRVT->bbuffer = pipe->encoder.bbuffer;
+			PRVT->bcount  = pipe->encoder.bcount;
+		}
+	}
+	return 0;
+}
+
+#undef PJOBFREE
+#undef PJOBQUEUED
+#undef PJOBDONE
+
+#endif
+
+
+/* ***************************************************************************
+ * Mathfinder related code
+ *************************************************************************** */
+
+#if defined(__clang__)
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wcast-align"
 #endif
@@ -1866,12 +3440,73 @@ slidewindow(struct TDEFLTPrvt* state)
 #endif
 
 
+/* Moves the last window of the source buffer to the window buffer, the
+ * source tail is copied after it as usual */
+static uintxx
+endoneshot(struct TDEFLTPrvt* state)
+{
+	uintxx start;
+	uintxx total;
+
+	start = 0;
+	if (PRVT->cursor > WNDWSIZE) {
+		start = PRVT->cursor - WNDWSIZE;
+	}
+	total = (uintxx) (PRVT->inputend - PRVT->window) - start;
+	ctb_memcpy(PRVT->wbuffer, PRVT->window + start, total);
+
+	PRVT->window   = PRVT->wbuffer;
+	PRVT->inputend = PRVT->wbuffer + total;
+	PRVT->cursor  -= start;
+	return start;
+}
+
 static uintxx
 fillwindow(struct TDEFLTPrvt* state)
 {
 	uintxx total;
 	uintxx wleft;
 
+	if (CTB_EXPECT0(PRVT->window != PRVT->wbuffer)) {
+		uintxx slide;
+
+		slide = endoneshot(PRVT);
+		PRVT->whence3 -= slide;
+		PRVT->whence4 -= slide;
+		PRVT->bstart  -= slide;
+		PRVT->pbend   -= slide;
+	}
+
+	if (PRVT->mirror) {
+		uintxx oldest;
+		uintxx used;
+
+		total = (uintxx) (PBLC->send - PBLC->source);
+		if (PRVT->cursor >= PRVT->mirror + WNDWSIZE) {
+			/* same bytes one view lower */
+			PRVT->cursor   -= PRVT->mirror;
+			PRVT->inputend -= PRVT->mirror;
+			PRVT->whence3  -= PRVT->mirror;
+			PRVT->whence4  -= PRVT->mirror;
+			PRVT->bstart   -= PRVT->mirror;
+			PRVT->pbend    -= PRVT->mirror;
+		}
+
+		/* the new bytes can't overwrite the window */
+		oldest = 0;
+		if (PRVT->cursor > WNDWSIZE) {
+			oldest = PRVT->cursor - WNDWSIZE;
+		}
+		oldest += PRVT->mirror;
+
+		used  = (uintxx) (PRVT->inputend - PRVT->window);
+		wleft = (uintxx) (PRVT->windowend - PRVT->inputend);
+		if (wleft > oldest - used) {
+			wleft = oldest - used;
+		}
+		goto L_COPY;
+	}
+
 	wleft = (uintxx) (PRVT->windowend - PRVT->inputend);
 	total = (uintxx) (PBLC->send - PBLC->source);
 
@@ -1881,10 +3516,13 @@ fillwindow(struct TDEFLTPrvt* state)
 		slide = slidewindow(PRVT);
 		PRVT->whence3 -= slide;
 		PRVT->whence4 -= slide;
+		PRVT->bstart  -= slide;
+		PRVT->pbend   -= slide;
 
 		wleft = (uintxx) (PRVT->windowend - PRVT->inputend);
 	}
 
+L_COPY:
 	if (total > wleft) {
 		total = wleft;
 	}
@@ -1896,20 +3534,52 @@ fillwindow(struct TDEFLTPrvt* state)
 	return total;
 }
 
+/* Rebases the positions by REBASEPOINT, the ones that become out of the
+ * window are set to the lowest value */
+#if defined(DEFLT_POSITION16)
+	#define REBASE(X) ((int16) (0x8000 | ((X) & ~((X) >> 15))))
+#else
+	#define REBASE(X) \
+		((int32) (0x80000000ul | (uint32) ((X) & ~((X) >> 31))))
+#endif
+
 static void
 slidehash(struct TDEFLTPrvt* state)
 {
 	uintxx j;
-	int16* buffer;
+	uintxx n;
+	TPosition* buffer;
+
+	if (PRVT->buckets) {
+		uintxx i;
+
+		for (j = 0; j < BMASK + 1; j++) {
+			buffer = PRVT->buckets[j].positions;
+			for (i = 0; i < BUCKETSIZE; i++) {
+				buffer[i] = REBASE(buffer[i]);
+			}
+		}
+		return;
+	}
 
-	for (j = 0, buffer = PRVT->mhlist; j < HMASK + 1; j++) {
-		buffer[j] = (int16) (0x8000 | (buffer[j] & ~(buffer[j] >> 15)));
+	n = (uintxx) 1 << PRVT->hashbits;
+	for (j = 0, buffer = PRVT->mhlist; j < n; j++) {
+		buffer[j] = REBASE(buffer[j]);
+	}
+	if (PRVT->btree) {
+		buffer = PRVT->btree;
+		for (j = 0; j < (CMASK + 1) << 1; j++) {
+			buffer[j] = REBASE(buffer[j]);
+		}
+		return;
 	}
 	for (j = 0, buffer = PRVT->mchain; j < CMASK + 1; j++) {
-		buffer[j] = (int16) (0x8000 | (buffer[j] & ~(buffer[j] >> 15)));
+		buffer[j] = REBASE(buffer[j]);
 	}
 }
 
+#undef REBASE
+
 
 #if !defined(CTB_STRICTALIGNMENT) && defined(CTB_FASTUNALIGNED)
 	#define GETSHEAD4(B, N) ((*((uint32*) ((B) + (N)))))
@@ -1947,35 +3617,162 @@ gethash(uint32 head, uintxx bits)
 }
 
 
-#if !defined(CTB_STRICTALIGNMENT) && defined(CTB_FASTUNALIGNED)
+#if defined(DEFLT_SIMDMATCH)
+
+#include <immintrin.h>
+#if defined(__MSVC__)
+	#include <intrin.h>
+#endif
 
 #if defined(__GNUC__)
-	#if defined(CTB_ENV64)
-		#define CTZERO(X) __builtin_ctzll(X)
-	#else
-		#define CTZERO(X) __builtin_ctzl(X)
-	#endif
+	#define CTZERO(X) ((uint32) __builtin_ctz(X))
+	#define TARGETAVX2 __attribute__((target("avx2")))
 #else
-	#if defined(__has_builtin)
-		#if defined(CTB_ENV64)
-			#if __has_builtin(__builtin_ctzll)
-				#define CTZERO(X) __builtin_ctzll(X)
-			#endif
-		#else
-			#if __has_builtin(__builtin_ctzl)
-				#define CTZERO(X) __builtin_ctzl(X)
-			#endif
-		#endif
-	#endif
+	CTB_FORCEINLINE uint32
+	ctzero(uint32 n)
+	{
+		unsigned long r;
+
+		_BitScanForward(&r, n);
+		return (uint32) r;
+	}
+
+	#define CTZERO(X) ctzero(X)
+	#define TARGETAVX2
 #endif
 
-#if CTB_IS_BIGENDIAN
-	#undef CTZERO
+#if defined(__clang__)
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wcast-align"
+#endif
+
+#define LOAD128(P) _mm_loadu_si128((const __m128i*) (P))
+#define LOAD256(P) _mm256_loadu_si256((const __m256i*) (P))
+
+static uint32
+matchlengthsse2(const uint8* p1, const uint8* p2)
+{
+	uint32 i;
+	uint32 mask;
+
+	for (i = 16; i < 258; i += 16) {
+		mask = (uint32) _mm_movemask_epi8(
+			_mm_cmpeq_epi8(LOAD128(p1 + i), LOAD128(p2 + i)));
+		if (mask ^ 0xffff) {
+			i += CTZERO(mask ^ 0xffff);
+			return i > 258 ? 258 : i;
+		}
+	}
+	return 258;
+}
+
+TARGETAVX2 static uint32
+matchlengthavx2(const uint8* p1, const uint8* p2)
+{
+	uint32 i;
+	uint32 mask;
+
+	for (i = 16; i < 258; i += 32) {
+		mask = (uint32) _mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(LOAD256(p1 + i), LOAD256(p2 + i)));
+		if (~mask) {
+			i += CTZERO(~mask);
+			return i > 258 ? 258 : i;
+		}
+	}
+	return 258;
+}
+
+static bool
+hasavx2(void)
+{
+#if defined(__GNUC__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return 0;
+	}
+
+	/* OSXSAVE and AVX, then the OS must save the ymm registers */
+	__cpuid(info, 1);
+	if ((info[2] & 0x18000000) != 0x18000000) {
+		return 0;
+	}
+	if ((_xgetbv(0) & 0x06) != 0x06) {
+		return 0;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & 0x20) != 0;
+#endif
+}
+
+static void
+setmatchlength(struct TDEFLTPrvt* state)
+{
+	if (hasavx2()) {
+		PRVT->matchlength = matchlengthavx2;
+	}
+	else {
+		PRVT->matchlength = matchlengthsse2;
+	}
+}
+
+CTB_FORCEINLINE uint32
+getmatchlength(struct TDEFLTPrvt* state, const uint8* p1, const uint8* p2)
+{
+	uint32 mask;
+
+	mask = (uint32) _mm_movemask_epi8(
+		_mm_cmpeq_epi8(LOAD128(p1), LOAD128(p2))) ^ 0xffff;
+	if (mask) {
+		return CTZERO(mask);
+	}
+	return PRVT->matchlength(p1, p2);
+}
+
+#undef LOAD128
+#undef LOAD256
+#undef TARGETAVX2
+#undef CTZERO
+
+#if defined(__clang__)
+	#pragma clang diagnostic pop
+#endif
+
+#elif !defined(CTB_STRICTALIGNMENT) && defined(CTB_FASTUNALIGNED)
+
+#if defined(__GNUC__)
+	#if defined(CTB_ENV64)
+		#define CTZERO(X) __builtin_ctzll(X)
+	#else
+		#define CTZERO(X) __builtin_ctzl(X)
+	#endif
+#else
+	#if defined(__has_builtin)
+		#if defined(CTB_ENV64)
+			#if __has_builtin(__builtin_ctzll)
+				#define CTZERO(X) __builtin_ctzll(X)
+			#endif
+		#else
+			#if __has_builtin(__builtin_ctzl)
+				#define CTZERO(X) __builtin_ctzl(X)
+			#endif
+		#endif
+	#endif
+#endif
+
+#if CTB_IS_BIGENDIAN
+	#undef CTZERO
 #endif
 
 
 CTB_FORCEINLINE uint32
-getmatchlength(const uint8* p1, const uint8* p2)
+getmatchlength(struct TDEFLTPrvt* state, const uint8* p1, const uint8* p2)
 {
 	const uint8* pp;
 	const uint8* limit;
@@ -1994,6 +3791,8 @@ getmatchlength(const uint8* p1, const uint8* p2)
 #endif
 #endif
 
+	(void) state;
+
 	pp = p1;
 	c1 = (const void*) p1;
 	c2 = (const void*) p2;
@@ -2065,11 +3864,13 @@ L1:
 #else
 
 CTB_FORCEINLINE uint32
-getmatchlength(const uint8* p1, const uint8* p2)
+getmatchlength(struct TDEFLTPrvt* state, const uint8* p1, const uint8* p2)
 {
 	const uint8* pp;
 	const uint8* limit;
 
+	(void) state;
+
 	pp = p1;
 	if (*p1++ != *p2++) {
 		goto L1;
@@ -2103,10 +3904,319 @@ L1:
 #endif
 
 
+/* Inserts the string at strbgn (position4 relative to whence4) in the binary
+ * tree of the hash h4, and searches for matches longer than length on the way
+ * down. Every longer match found is added to m when m is not NULL. */
+CTB_FORCEINLINE uint32
+btsearch(struct TDEFLTPrvt* state, uint8* strbgn, uint32 position4, uint32 h4,
+	uint32 length, uint32 maxlength, uint32 depth, uint8** offset,
+	struct TOptMatch* m, uintxx* n)
+{
+	uint8* pmatch;
+	TPosition* btree;
+	TPosition* plt;
+	TPosition* pgt;
+	TPosition node;
+	TPosition limit;
+	uint32 nice;
+	uint32 ltlength;
+	uint32 gtlength;
+	uint32 r;
+
+	if (maxlength < MINMATCH) {
+		return length;
+	}
+
+	nice = PRVT->nicelength;
+	if (nice > maxlength) {
+		nice = maxlength;
+	}
+
+	btree = PRVT->btree;
+	node = PRVT->mhlist[h4];
+	PRVT->mhlist[h4] = (TPosition) position4;
+
+	plt = btree + ((position4 & CMASK) << 1);
+	pgt = plt + 1;
+
+	limit = (TPosition) (position4 - WNDWSIZE);
+	if (node <= limit) {
+		*plt = (TPosition) -(WNDWSIZE);
+		*pgt = (TPosition) -(WNDWSIZE);
+		return length;
+	}
+
+	ltlength = 0;
+	gtlength = 0;
+	r = 0;
+	for (;;) {
+		pmatch = PRVT->window + (((intxx) PRVT->whence4) + node);
+		if (pmatch[r] == strbgn[r]) {
+			r += getmatchlength(PRVT, strbgn + r, pmatch + r);
+			if (r > maxlength) {
+				r = maxlength;
+			}
+
+			if (r > length) {
+				length = r;
+				offset[0] = pmatch;
+				if (m) {
+					if (n[0] == OPTMAXMATCHES) {
+						n[0]--;
+					}
+					m[n[0]].length = (uint16) r;
+					m[n[0]].offset = (uint16) (strbgn - pmatch);
+					n[0]++;
+				}
+			}
+
+			if (r >= nice) {
+				if (nice < PRVT->nicelength) {
+					/* the input ends before the nice length, the order of
+					 * the node subtrees is not known so they are dropped */
+					break;
+				}
+
+				/* replace the node */
+				*plt = btree[(((uint32) node & CMASK) << 1) + 0];
+				*pgt = btree[(((uint32) node & CMASK) << 1) + 1];
+				return length;
+			}
+		}
+
+		if (pmatch[r] < strbgn[r]) {
+			*plt = node;
+			plt  = btree + (((uint32) node & CMASK) << 1) + 1;
+			node = *plt;
+
+			ltlength = r;
+			if (r > gtlength) {
+				r = gtlength;
+			}
+		}
+		else {
+			*pgt = node;
+			pgt  = btree + (((uint32) node & CMASK) << 1) + 0;
+			node = *pgt;
+
+			gtlength = r;
+			if (r > ltlength) {
+				r = ltlength;
+			}
+		}
+
+		if (node <= limit || --depth == 0) {
+			break;
+		}
+	}
+
+	*plt = (TPosition) -(WNDWSIZE);
+	*pgt = (TPosition) -(WNDWSIZE);
+	return length;
+}
+
+/* Adds a position to the bucket of the hash h (bucket index and check byte) */
+CTB_FORCEINLINE void
+bucketinsert(struct TDEFLTPrvt* state, uint32 h, uint32 position4)
+{
+	struct TDEFLTBucket* bucket;
+	uintxx i;
+
+	bucket = PRVT->buckets + (h >> 8);
+	i = bucket->head;
+	if (i == 0) {
+		i = BUCKETSIZE;
+	}
+	i--;
+	bucket->positions[i] = (TPosition) position4;
+	bucket->checks[i] = (uint8) h;
+	bucket->head = (uint8) i;
+}
+
+#if defined(DEFLT_SIMDMATCH)
+
+#if defined(__GNUC__)
+	#define CTZERO(X) ((uintxx) __builtin_ctz(X))
+#else
+	CTB_FORCEINLINE uintxx
+	ctzero(uint32 n)
+	{
+		unsigned long r;
+
+		_BitScanForward(&r, n);
+		return (uintxx) r;
+	}
+
+	#define CTZERO(X) ctzero(X)
+#endif
+
+/* offset of the second load of check bytes */
+#define RLOAD (BUCKETSIZE > 16 ? BUCKETSIZE - 16 : 0)
+
+/* Searches the bucket of the hash h from the most recent position, only the
+ * entries with the same check byte are read from the window */
+CTB_FORCEINLINE uint32
+bucketsearch(struct TDEFLTPrvt* state, uint8* strbgn, uint32 h,
+	uint32 position4, uint32 length, uint8** offset)
+{
+	struct TDEFLTBucket* bucket;
+	uint8* pmatch;
+	uintxx i;
+	uint32 chain;
+	uint32 mask;
+	uint32 rest;
+	__m128i c;
+	TPosition next4;
+	TPosition limit;
+
+	bucket = PRVT->buckets + (h >> 8);
+	c = _mm_set1_epi8((char) (uint8) h);
+	mask = (uint32) _mm_movemask_epi8(
+		_mm_cmpeq_epi8(_mm_loadu_si128((void*) (bucket->checks + 0)), c));
+	if (BUCKETSIZE > 16) {
+		mask |= (uint32) _mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_loadu_si128((void*) (bucket->checks + RLOAD)), c))
+			<< RLOAD;
+	}
+	mask &= (uint32) ((1ul << BUCKETSIZE) - 1);
+
+	/* the ring from head to the end then from the start to head */
+	rest = mask & (uint32) ((1ul << bucket->head) - 1);
+	mask = mask ^ rest;
+
+	chain = PRVT->maxchain;
+	for (limit = (TPosition) (position4 - WNDWSIZE); chain != 0; chain--) {
+		if (mask == 0) {
+			if (rest == 0) {
+				break;
+			}
+			mask = rest;
+			rest = 0;
+		}
+		i = CTZERO(mask);
+		mask &= mask - 1;
+
+		next4 = bucket->positions[i];
+		if (next4 <= limit) {
+			break;
+		}
+
+		pmatch = PRVT->window + (((intxx) PRVT->whence4) + next4);
+		if (strbgn[length] == pmatch[length]) {
+			uint32 n;
+
+			n = getmatchlength(PRVT, strbgn, pmatch);
+			if (n > length) {
+				length = n;
+				offset[0] = pmatch;
+				if (length >= PRVT->nicelength) {
+					break;
+				}
+			}
+		}
+	}
+	return length;
+}
+
+#undef RLOAD
+#undef CTZERO
+
+#else
+
+/* Searches the bucket of the hash h from the most recent position, the
+ * entries with a different check byte are skipped without reading the
+ * window */
+CTB_FORCEINLINE uint32
+bucketsearch(struct TDEFLTPrvt* state, uint8* strbgn, uint32 h,
+	uint32 position4, uint32 length, uint8** offset)
+{
+	struct TDEFLTBucket* bucket;
+	uint8* pmatch;
+	uintxx i;
+	uintxx j;
+	uint32 chain;
+	uint8 check;
+	TPosition next4;
+	TPosition limit;
+
+	bucket = PRVT->buckets + (h >> 8);
+	check = (uint8) h;
+
+	chain = PRVT->maxchain;
+	i = bucket->head;
+	limit = (TPosition) (position4 - WNDWSIZE);
+	for (j = 0; j < BUCKETSIZE && chain != 0; j++) {
+		next4 = bucket->positions[i];
+		if (next4 <= limit) {
+			break;
+		}
+
+		if (bucket->checks[i] == check) {
+			pmatch = PRVT->window + (((intxx) PRVT->whence4) + next4);
+			if (strbgn[length] == pmatch[length]) {
+				uint32 n;
+
+				n = getmatchlength(PRVT, strbgn, pmatch);
+				if (n > length) {
+					length = n;
+					offset[0] = pmatch;
+					if (length >= PRVT->nicelength) {
+						break;
+					}
+				}
+			}
+			chain--;
+		}
+
+		if (++i == BUCKETSIZE) {
+			i = 0;
+		}
+	}
+	return length;
+}
+
+#endif
+
+
+/* Drops the hash entries of the last stream without clearing the tables, the
+ * positions of the next stream start a window past the last one so the old
+ * entries are out of the window as the empty ones. The short hash table has
+ * 16 bit positions, it's cleared at the hashes of the positions the stream
+ * used */
+static void
+rewindcache(struct TDEFLTPrvt* state)
+{
+	uintxx i;
+	uintxx start;
+
+	start = (TUPosition) (PRVT->cursor - PRVT->whence4);
+	start = start + WNDWSIZE + 1;
+	if (PRVT->dirty || PRVT->whence3 || start > REBASEPOINT - WNDWSIZE) {
+		resetcache(PRVT);
+		PRVT->whence4 = 0;
+		return;
+	}
+
+	if (PRVT->shlist) {
+		if (PRVT->cursor > QMASK) {
+			for (i = 0; i < QMASK + 1; i++) {
+				PRVT->shlist[i] = 0;
+			}
+		}
+		else {
+			for (i = 0; i <= PRVT->cursor; i++) {
+				PRVT->shlist[gethash(gethead(PRVT, i) >> 010, QBITS)] = 0;
+			}
+		}
+	}
+	PRVT->whence4 = (uintxx) 0 - start;
+}
+
 void
 deflator_setdctnr(TDeflator* state, const uint8* dict, uintxx size)
 {
 	uintxx i;
+	uintxx w4;
 	CTB_ASSERT(state && dict && size);
 
 	if (PRVT->level == 0) {
@@ -2126,7 +4236,9 @@ deflator_setdctnr(TDeflator* state, const uint8* dict, uintxx size)
 	}
 	ctb_memcpy(PRVT->window, dict, size);
 
-	if (PRVT->level > 5) {
+	/* the positions are relative to whence4 (see rewindcache) */
+	w4 = PRVT->whence4;
+	if (PRVT->shlist) {
 		if (size >= 4) {
 			uintxx j;
 
@@ -2138,10 +4250,24 @@ deflator_setdctnr(TDeflator* state, const uint8* dict, uintxx size)
 
 				hs = gethead(PRVT, i);
 				h3 = gethash(hs >> 010, QBITS);
-				h4 = gethash(hs >> 000, HBITS);
+				h4 = gethash(hs >> 000, PRVT->hashbits);
+
+				if (PRVT->btree) {
+					uint8* offset;
+					uintxx maxlength;
 
-				PRVT->mchain[i & CMASK] = PRVT->mhlist[h4];
-				PRVT->mhlist[h4] = ( int16) i;
+					maxlength = size - i;
+					if (maxlength > MAXMATCH) {
+						maxlength = MAXMATCH;
+					}
+					btsearch(PRVT, PRVT->window + i, (TUPosition) (i - w4), h4,
+						MAXMATCH, (uint32) maxlength, PRVT->maxchain, &offset,
+						NULL, NULL);
+				}
+				else {
+					PRVT->mchain[(i - w4) & CMASK] = PRVT->mhlist[h4];
+					PRVT->mhlist[h4] = (TPosition) (i - w4);
+				}
 				PRVT->schain[i & QMASK] = PRVT->shlist[h3];
 				PRVT->shlist[h3] = (uint16) i;
 			}
@@ -2155,60 +4281,390 @@ deflator_setdctnr(TDeflator* state, const uint8* dict, uintxx size)
 			for (i = 0; i <= j; i++) {
 				uint32 h4;
 
-				h4 = gethash(gethead(PRVT, i), HBITS);
-				PRVT->mchain[i & CMASK] = PRVT->mhlist[h4];
-				PRVT->mhlist[h4] = (int16) i;
+				if (PRVT->buckets) {
+					h4 = gethash(gethead(PRVT, i), BBITS + 8);
+					bucketinsert(PRVT, h4, (TUPosition) (i - w4));
+					continue;
+				}
+				h4 = gethash(gethead(PRVT, i), PRVT->hashbits);
+				PRVT->mchain[(i - w4) & CMASK] = PRVT->mhlist[h4];
+				PRVT->mhlist[h4] = (TPosition) (i - w4);
 			}
 		}
 	}
 	PRVT->inputend += size;
 	PRVT->cursor    = size;
+	PRVT->bstart    = size;
+	PRVT->pbend     = size + PROBESIZE;
 	PRVT->used = 1;
 }
 
-static const uint8 dsymbols[] = {
-	0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x04, 0x05,
-	0x05, 0x06, 0x06, 0x06, 0x06, 0x07, 0x07, 0x07,
-	0x07, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
-	0x08, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09,
-	0x09, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,
-	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,
-	0x0a, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
-	0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
-	0x0b, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c,
-	0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c,
-	0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c,
-	0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c,
-	0x0c, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d,
-	0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d,
-	0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d,
-	0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d,
-	0x0d, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
-	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
-	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
-	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
-	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
-	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
-	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
-	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
-	0x0e, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
-	0x00, 0x0f, 0x10, 0x11, 0x12, 0x12, 0x13, 0x13,
-	0x14, 0x14, 0x14, 0x14, 0x15, 0x15, 0x15, 0x15,
-	0x16, 0x16, 0x16, 0x16, 0x16, 0x16, 0x16, 0x16,
-	0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17,
-	0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18,
-	0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18,
-	0x19, 0x19, 0x19, 0x19, 0x19, 0x19, 0x19, 0x19,
-	0x19, 0x19, 0x19, 0x19, 0x19, 0x19, 0x19, 0x19,
-	0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a,
-	0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a,
+/* Shared dictionary, the window bytes and the entries that deflator_setdctnr
+ * leaves in the tables (positions relative to the dictionary start) */
+struct TDEFLTDctnr {
+	const struct TAllocator* allctr;
+	uintxx total;
+
+	/* layout of the tables it was built for */
+	uint32 hashbits;
+	uint32 tables;
+
+	/* number of entries of each list, npositions is the number of hashed
+	 * positions (the chain or tree entries) */
+	uintxx npositions;
+	uintxx nheads;
+	uintxx nbuckets;
+	uintxx nshorts;
+	uintxx nschain;
+
+	uintxx size;
+	uint8* window;
+
+	struct TDEFLTBucket* buckets;
+	TPosition* heads;
+	TPosition* chain;
+	uint32* hslots;
+	uint32* bslots;
+	uint32* sslots;
+	uint16* shorts;
+	uint16* schain;
+};
+
+#define TABLESHORT  0x01
+#define TABLEBTREE  0x02
+#define TABLEBUCKET 0x04
+
+CTB_INLINE uint32
+gettables(struct TDEFLTPrvt* state)
+{
+	uint32 tables;
+
+	tables = 0;
+	if (PRVT->shlist) {
+		tables |= TABLESHORT;
+	}
+	if (PRVT->btree) {
+		tables |= TABLEBTREE;
+	}
+	if (PRVT->buckets) {
+		tables |= TABLEBUCKET;
+	}
+	return tables;
+}
+
+#define DCTNR ((const struct TDEFLTDctnr*) dctnr)
+
+TDeflatorDctnr*
+deflator_createdctnr(const TDeflatorParams* params, const uint8* dict,
+	uintxx size, const TAllocator* allctr)
+{
+	uintxx i;
+	uintxx n;
+	uintxx nheads;
+	uintxx nbuckets;
+	uintxx nshorts;
+	uintxx nschain;
+	uintxx npositions;
+	uint8* p;
+	struct TDEFLTPrvt* state;
+	struct TDEFLTDctnr* dctnr;
+	CTB_ASSERT(params && dict && size);
+
+	if (params->level == 0) {
+		return NULL;
+	}
+	if (allctr == NULL) {
+		allctr = ctb_getdefaultallocator();
+		if (allctr == NULL) {
+			return NULL;
+		}
+	}
+
+	/* the tables are built by an instance with the same parameters */
+	state = (struct TDEFLTPrvt*) deflator_createex(params, allctr);
+	if (state == NULL) {
+		return NULL;
+	}
+	deflator_setdctnr((TDeflator*) state, dict, size);
+	size = PRVT->cursor;
+
+	npositions = 0;
+	if (size >= 4) {
+		npositions = size - 3;
+	}
+
+	nheads   = 0;
+	nbuckets = 0;
+	if (PRVT->buckets) {
+		for (i = 0; i < BMASK + 1; i++) {
+			if (PRVT->buckets[i].positions[PRVT->buckets[i].head] >= 0) {
+				nbuckets++;
+			}
+		}
+	}
+	else {
+		for (i = 0; i < ((uintxx) 1 << PRVT->hashbits); i++) {
+			if (PRVT->mhlist[i] >= 0) {
+				nheads++;
+			}
+		}
+	}
+
+	nshorts = 0;
+	nschain = 0;
+	if (PRVT->shlist) {
+		for (i = 0; i < QMASK + 1; i++) {
+			if (PRVT->shlist[i]) {
+				nshorts++;
+			}
+		}
+		nschain = npositions;
+		if (nschain > QMASK + 1) {
+			nschain = QMASK + 1;
+		}
+	}
+
+	n = npositions;
+	if (PRVT->btree) {
+		n = npositions << 1;
+	}
+	if (PRVT->buckets) {
+		n = 0;
+	}
+	n = sizeof(struct TDEFLTDctnr) +
+		nbuckets * (sizeof(struct TDEFLTBucket) + sizeof(uint32)) +
+		nheads   * (sizeof(TPosition) + sizeof(uint32)) +
+		n        * (sizeof(TPosition)) +
+		nshorts  * (sizeof(uint16) + sizeof(uint32)) +
+		nschain  * (sizeof(uint16)) + size;
+
+	dctnr = allctr->request(n, allctr->user);
+	if (dctnr == NULL) {
+		deflator_destroy((TDeflator*) state);
+		return NULL;
+	}
+	dctnr->allctr = allctr;
+	dctnr->total  = n;
+
+	dctnr->hashbits = PRVT->hashbits;
+	dctnr->tables   = gettables(PRVT);
+	dctnr->npositions = npositions;
+	dctnr->nheads   = nheads;
+	dctnr->nbuckets = nbuckets;
+	dctnr->nshorts  = nshorts;
+	dctnr->nschain  = nschain;
+	dctnr->size = size;
+
+	/* from the largest alignment to the smallest */
+	p = (uint8*) (dctnr + 1);
+	dctnr->buckets = (struct TDEFLTBucket*) p;
+	p += nbuckets * sizeof(struct TDEFLTBucket);
+	dctnr->heads = (TPosition*) p;
+	p += nheads * sizeof(TPosition);
+	dctnr->chain = (TPosition*) p;
+	if (PRVT->buckets == NULL) {
+		p += (npositions << (PRVT->btree != NULL)) * sizeof(TPosition);
+	}
+	dctnr->hslots = (uint32*) p;
+	p += nheads * sizeof(uint32);
+	dctnr->bslots = (uint32*) p;
+	p += nbuckets * sizeof(uint32);
+	dctnr->sslots = (uint32*) p;
+	p += nshorts * sizeof(uint32);
+	dctnr->shorts = (uint16*) p;
+	p += nshorts * sizeof(uint16);
+	dctnr->schain = (uint16*) p;
+	p += nschain * sizeof(uint16);
+	dctnr->window = p;
+	ctb_memcpy(dctnr->window, PRVT->window, size);
+
+	if (PRVT->buckets) {
+		for (n = 0, i = 0; i < BMASK + 1; i++) {
+			if (PRVT->buckets[i].positions[PRVT->buckets[i].head] >= 0) {
+				dctnr->buckets[n] = PRVT->buckets[i];
+				dctnr->bslots[n++] = (uint32) i;
+			}
+		}
+	}
+	else {
+		for (n = 0, i = 0; i < ((uintxx) 1 << PRVT->hashbits); i++) {
+			if (PRVT->mhlist[i] >= 0) {
+				dctnr->heads[n] = PRVT->mhlist[i];
+				dctnr->hslots[n++] = (uint32) i;
+			}
+		}
+
+		/* the instance is new so the positions start at zero */
+		if (PRVT->btree) {
+			for (i = 0; i < npositions << 1; i++) {
+				dctnr->chain[i] = PRVT->btree[i];
+			}
+		}
+		else {
+			for (i = 0; i < npositions; i++) {
+				dctnr->chain[i] = PRVT->mchain[i];
+			}
+		}
+	}
+
+	if (PRVT->shlist) {
+		for (n = 0, i = 0; i < QMASK + 1; i++) {
+			if (PRVT->shlist[i]) {
+				dctnr->shorts[n] = PRVT->shlist[i];
+				dctnr->sslots[n++] = (uint32) i;
+			}
+		}
+		for (i = 0; i < nschain; i++) {
+			dctnr->schain[i] = PRVT->schain[i];
+		}
+	}
+
+	deflator_destroy((TDeflator*) state);
+	return (TDeflatorDctnr*) dctnr;
+}
+
+void
+deflator_destroydctnr(TDeflatorDctnr* dctnr)
+{
+	const struct TAllocator* a;
+
+	if (dctnr == NULL) {
+		return;
+	}
+	a = DCTNR->allctr;
+	a->dispose(dctnr, DCTNR->total, a->user);
+}
+
+void
+deflator_attachdctnr(TDeflator* state, const TDeflatorDctnr* dctnr)
+{
+	uintxx i;
+	uint32 start;
+	CTB_ASSERT(state && dctnr);
+
+	if (PRVT->level == 0) {
+		return;
+	}
+	else {
+		if (PRVT->used) {
+			SETERROR(DEFLT_EINCORRECTUSE);
+			SETSTATE(0xDEADBEEF);
+			return;
+		}
+	}
+
+	if (DCTNR->tables != gettables(PRVT) ||
+		DCTNR->hashbits != PRVT->hashbits) {
+		deflator_setdctnr(state, DCTNR->window, DCTNR->size);
+		return;
+	}
+	ctb_memcpy(PRVT->window, DCTNR->window, DCTNR->size);
+
+	/* the positions are relative to whence4 (see rewindcache) */
+	start = (TUPosition) (0 - PRVT->whence4);
+
+#define REBASED(X) ((TPosition) (TUPosition) ((uint32) (X) + start))
+
+	if (PRVT->buckets) {
+		for (i = 0; i < DCTNR->nbuckets; i++) {
+			struct TDEFLTBucket* bucket;
+			uintxx j;
+
+			bucket = PRVT->buckets + DCTNR->bslots[i];
+			bucket[0] = DCTNR->buckets[i];
+			for (j = 0; j < BUCKETSIZE; j++) {
+				bucket->positions[j] = REBASED(bucket->positions[j]);
+			}
+		}
+	}
+	else {
+		for (i = 0; i < DCTNR->nheads; i++) {
+			PRVT->mhlist[DCTNR->hslots[i]] = REBASED(DCTNR->heads[i]);
+		}
+
+		if (PRVT->btree) {
+			for (i = 0; i < DCTNR->npositions; i++) {
+				uintxx j;
+
+				j = (uintxx) ((i + start) & CMASK) << 1;
+				PRVT->btree[j + 0] = REBASED(DCTNR->chain[(i << 1) + 0]);
+				PRVT->btree[j + 1] = REBASED(DCTNR->chain[(i << 1) + 1]);
+			}
+		}
+		else {
+			for (i = 0; i < DCTNR->npositions; i++) {
+				PRVT->mchain[(i + start) & CMASK] = REBASED(DCTNR->chain[i]);
+			}
+		}
+	}
+
+#undef REBASED
+
+	/* the short positions are relative to whence3 (zero) */
+	if (PRVT->shlist) {
+		for (i = 0; i < DCTNR->nshorts; i++) {
+			PRVT->shlist[DCTNR->sslots[i]] = DCTNR->shorts[i];
+		}
+		for (i = 0; i < DCTNR->nschain; i++) {
+			PRVT->schain[i] = DCTNR->schain[i];
+		}
+	}
+
+	PRVT->inputend += DCTNR->size;
+	PRVT->cursor    = DCTNR->size;
+	PRVT->bstart    = DCTNR->size;
+	PRVT->pbend     = DCTNR->size + PROBESIZE;
+	PRVT->used = 1;
+}
+
+#undef DCTNR
+#undef TABLESHORT
+#undef TABLEBTREE
+#undef TABLEBUCKET
+
+static const uint8 dsymbols[] = {
+	0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x04, 0x05,
+	0x05, 0x06, 0x06, 0x06, 0x06, 0x07, 0x07, 0x07,
+	0x07, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
+	0x08, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09,
+	0x09, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,
+	0x0a, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+	0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+	0x0b, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c,
+	0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c,
+	0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c,
+	0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c,
+	0x0c, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d,
+	0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d,
+	0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d,
+	0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d, 0x0d,
+	0x0d, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
+	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
+	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
+	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
+	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
+	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
+	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
+	0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
+	0x0e, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x00, 0x0f, 0x10, 0x11, 0x12, 0x12, 0x13, 0x13,
+	0x14, 0x14, 0x14, 0x14, 0x15, 0x15, 0x15, 0x15,
+	0x16, 0x16, 0x16, 0x16, 0x16, 0x16, 0x16, 0x16,
+	0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17, 0x17,
+	0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18,
+	0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18,
+	0x19, 0x19, 0x19, 0x19, 0x19, 0x19, 0x19, 0x19,
+	0x19, 0x19, 0x19, 0x19, 0x19, 0x19, 0x19, 0x19,
+	0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a,
+	0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a,
 	0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a,
 	0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a, 0x1a,
 	0x1b, 0x1b, 0x1b, 0x1b, 0x1b, 0x1b, 0x1b, 0x1b,
@@ -2291,26 +4747,138 @@ struct TMatch {
 };
 
 CTB_FORCEINLINE void
-addmatch(struct TDEFLTPrvt* state, struct TMatch match, uintxx ls, uintxx ds)
+addmatch(struct TDEFLTPrvt* state, struct TMatch match, uintxx ds)
 {
-	/* token layout:
-	 *        length       distance            length symbol and distance
-	 * 1------a aaaaaaaa | bbbbbbbb bbbbbbbb | cccccccc dddddddd */
-	PRVT->zend[0] = (uint16) (match.length | 0x8000);
-	PRVT->zend[1] = (uint16) (match.offset);
-	PRVT->zend++;
-	PRVT->zend++;
-	PRVT->zend[0] = (uint16) ((ls << 0x08) | (ds << 0x00));
+	uint32 token;
+
+	/* token layout (literals are just the symbol):
+	 *  distance extra  distance  match flag  length - 3
+	 * aaaaaaaaaaaaa   bbbbb     1           cccccccc */
+	token  = (uint32) (match.length - 3) | 0x200;
+	token |= (uint32) ds << 0x0a;
+	token |= (uint32) (match.offset - sdstcodes[ds].base) << 0x0f;
+	PRVT->zend[0] = token;
 	PRVT->zend++;
 }
 
 CTB_FORCEINLINE void
 addliteral(struct TDEFLTPrvt* state, uintxx literal)
 {
-	PRVT->zend[0] = (uint16) literal;
+	PRVT->zend[0] = (uint32) literal;
 	PRVT->zend++;
 }
 
+
+/* ***************************************************************************
+ * Block splitter (level 2 to 9)
+ *************************************************************************** */
+
+/* The block is checked every SPLITSPAN tokens */
+#define SPLITSPAN 0x1000
+
+/* Checks if the block should end at the split point candidate, in that case
+ * the token list is ended there and the frequencies are set to the ones of
+ * the block; otherwise the end of the list becomes the new candidate */
+static bool
+splitblock(struct TDEFLTPrvt* state)
+{
+	uintxx i;
+	uintxx end;
+	uintxx joined;
+	uintxx splitted;
+	uint32* lzlist;
+	struct TDEFLTExtra* e;
+	struct TDEFLTSplitter* s;
+
+	e = PRVT->extra;
+	s = PRVT->splitter;
+
+	end = (uintxx) (PRVT->zend - PRVT->lzlist);
+	if (s->mark == 0) {
+		goto L_MARK;
+	}
+
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		s->tlfrqs[i] = e->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		s->tdfrqs[i] = e->dfrqs[i];
+	}
+	joined = dynamicbits(e, s->tlfrqs, s->tdfrqs);
+
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		s->tlfrqs[i] -= s->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		s->tdfrqs[i] -= s->dfrqs[i];
+	}
+	splitted  = dynamicbits(e, s->lfrqs, s->dfrqs);
+	splitted += dynamicbits(e, s->tlfrqs, s->tdfrqs);
+
+	if (splitted < joined) {
+		for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+			e->lfrqs[i] = s->lfrqs[i];
+		}
+		for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+			e->dfrqs[i] = s->dfrqs[i];
+		}
+
+		/* make room for the end of block symbol */
+		lzlist = PRVT->lzlist + s->mark;
+		for (i = end - s->mark; i; i--) {
+			lzlist[i] = lzlist[i - 1];
+		}
+		s->tail = end - s->mark;
+
+		PRVT->zend = lzlist;
+		return 1;
+	}
+
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		e->lfrqs[i] = s->tlfrqs[i] + s->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		e->dfrqs[i] = s->tdfrqs[i] + s->dfrqs[i];
+	}
+
+L_MARK:
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		s->lfrqs[i] = e->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		s->dfrqs[i] = e->dfrqs[i];
+	}
+	s->mark = end;
+	return 0;
+}
+
+/* Starts a new block with the tokens left by the last split */
+static void
+resetsplitter(struct TDEFLTPrvt* state)
+{
+	uintxx i;
+	uint32* lzlist;
+	struct TDEFLTSplitter* s;
+
+	s = PRVT->splitter;
+	if (s->tail) {
+		lzlist = PRVT->lzlist;
+		for (i = 0; s->tail > i; i++) {
+			lzlist[i] = lzlist[s->mark + 1 + i];
+		}
+		PRVT->zend = lzlist + s->tail;
+
+		for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+			PRVT->extra->lfrqs[i] = s->tlfrqs[i];
+		}
+		for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+			PRVT->extra->dfrqs[i] = s->tdfrqs[i];
+		}
+		s->tail = 0;
+	}
+	s->mark = 0;
+}
+
 #if defined(__clang__) && defined(CTB_FASTUNALIGNED)
 	#pragma clang diagnostic push
 	#pragma clang diagnostic ignored "-Wcast-align"
@@ -2329,49 +4897,175 @@ addliteral(struct TDEFLTPrvt* state, uintxx literal)
 
 
 /* ***************************************************************************
- * Greedy parser (level 1 2 3 4 5)
+ * Incompressible data probe (level 1 to 9)
  *************************************************************************** */
 
-CTB_FORCEINLINE struct TMatch
-getmatch1(struct TDEFLTPrvt* state, uint32 length, uint32 hash[1])
+/* While passing through the regions are smaller, a compressible region is
+ * emitted as literals until the probe sees it */
+#define RAWPROBESIZE (PROBESIZE >> 2)
+
+/* Number of small regions passed through before the match finder is tried
+ * again (the bytes can repeat even if they look random) */
+#define PROBERETRY 32
+
+/* Checks if the bytes of the region look uniformly distributed using a
+ * sample of one byte out of four */
+static bool
+isuniform(const uint8* buffer, uintxx size)
 {
-	uint8* strbgn;
-	uint8* strend;
-	uint8* pmatch;
-	uint8* offset;
-	uint32 chain;
-	uint32 position4;
-	uint32 head;
-	uint32 h4;
-	int16 next4;
-	int16 limit;
+	uintxx i;
+	uintxx n;
+	uintxx s;
+	uint32 frqs[256];
 
-	strbgn = strend = PRVT->window + PRVT->cursor;
-	strend = strend + MAXMATCH;
-	if (strend > PRVT->inputend) {
-		strend = PRVT->inputend;
+	for (i = 0; i < 256; i++) {
+		frqs[i] = 0;
+	}
+	for (i = 0; i < size; i += 4) {
+		frqs[buffer[i]]++;
 	}
-	offset = strbgn;
 
-	position4 = (uint16) (PRVT->cursor - PRVT->whence4);
-	if (CTB_EXPECT0(position4 == WNDWSIZE)) {
-		slidehash(state);
-		PRVT->whence4 += WNDWSIZE;
-		position4 = 0;
+	s = 0;
+	for (i = 0; i < 256; i++) {
+		s += (uintxx) frqs[i] * frqs[i];
 	}
-	h4 = hash[0];
-	next4 = PRVT->mhlist[h4];
 
-	PRVT->mchain[position4 & CMASK] = PRVT->mhlist[h4];
-	PRVT->mhlist[h4] = (int16) position4;
+	/* the sum of the squared frequencies of uniform bytes is close to
+	 * n * n / 256 plus n (the sampling noise), a skewed distribution that
+	 * Huffman codes can use adds more than 1/8 of n * n / 256 */
+	n = size >> 2;
+	return s < ((n * n) >> 8) + n + ((n * n) >> 11);
+}
 
-	head = gethead(state, PRVT->cursor + 1);
-	h4 = gethash(head, HBITS);
+/* Called at the end of each region, it returns 1 when the mode changes (the
+ * block must end there) */
+static bool
+probe(struct TDEFLTPrvt* state)
+{
+	uint32 position4;
+	const uint8* window;
+
+	window = PRVT->window;
+	if (PRVT->rawmode) {
+		/* the positions are not checked while passing through */
+		position4 = (TUPosition) (PRVT->cursor - PRVT->whence4);
+		if (position4 >= REBASEPOINT) {
+			slidehash(state);
+			PRVT->whence4 += REBASEPOINT;
+		}
+
+		PRVT->rawcount++;
+		if (PRVT->rawcount < PROBERETRY) {
+			window += PRVT->cursor - RAWPROBESIZE;
+			if (isuniform(window, RAWPROBESIZE)) {
+				PRVT->pbend = PRVT->cursor + RAWPROBESIZE;
+				return 0;
+			}
+		}
+		PRVT->pbend   = PRVT->cursor + PROBESIZE;
+		PRVT->pbmatch = 0;
+		PRVT->rawmode = 0;
+		return 1;
+	}
+
+	if (PRVT->pbmatch < (PROBESIZE >> 5)) {
+		window += PRVT->cursor - PROBESIZE;
+		if (isuniform(window, PROBESIZE)) {
+			PRVT->pbend    = PRVT->cursor + RAWPROBESIZE;
+			PRVT->rawmode  = 1;
+			PRVT->rawcount = 0;
+			return 1;
+		}
+	}
+	PRVT->pbend   = PRVT->cursor + PROBESIZE;
+	PRVT->pbmatch = 0;
+	return 0;
+}
+
+/* Emits the bytes as literals without searching for matches nor inserting
+ * them in the hash tables, it returns 1 when the block must end */
+CTB_FORCEINLINE bool
+passthrough(struct TDEFLTPrvt* state, uintxx limit)
+{
+	uintxx c;
+	uintxx* litfrqs;
+
+	litfrqs = PRVT->extra->lfrqs;
+	while (limit > PRVT->cursor) {
+		c = PRVT->window[PRVT->cursor++];
+		addliteral(state, c);
+		litfrqs[c]++;
+
+		if (CTB_EXPECT0(PRVT->zend + 2 > PRVT->lzlistend)) {
+			return 1;
+		}
+		if (CTB_EXPECT0(PRVT->cursor >= PRVT->pbend)) {
+			if (probe(state)) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+#undef RAWPROBESIZE
+#undef PROBERETRY
+
+
+/* ***************************************************************************
+ * Greedy parser (level 1 2 3 4 5)
+ *************************************************************************** */
+
+CTB_FORCEINLINE struct TMatch
+getmatch1(struct TDEFLTPrvt* state, uint32 length, uint32 hash[1])
+{
+	uint8* strbgn;
+	uint8* strend;
+	uint8* pmatch;
+	uint8* offset;
+	uint32 chain;
+	uint32 position4;
+	uint32 head;
+	uint32 h4;
+	TPosition next4;
+	TPosition limit;
+
+	strbgn = strend = PRVT->window + PRVT->cursor;
+	strend = strend + MAXMATCH;
+	if (strend > PRVT->inputend) {
+		strend = PRVT->inputend;
+	}
+	offset = strbgn;
+
+	position4 = (TUPosition) (PRVT->cursor - PRVT->whence4);
+	if (CTB_EXPECT0(position4 == REBASEPOINT)) {
+		slidehash(state);
+		PRVT->whence4 += REBASEPOINT;
+		position4 = 0;
+	}
+	h4 = hash[0];
+	if (PRVT->buckets) {
+		length = bucketsearch(state, strbgn, h4, position4, length, &offset);
+		bucketinsert(state, h4, position4);
+
+		head = gethead(state, PRVT->cursor + 1);
+		h4 = gethash(head, BBITS + 8);
+		PREFETCH(&PRVT->buckets[h4 >> 8]);
+		hash[0] = h4;
+		goto L1;
+	}
+	next4 = PRVT->mhlist[h4];
+
+	PRVT->mchain[position4 & CMASK] = PRVT->mhlist[h4];
+	PRVT->mhlist[h4] = (TPosition) position4;
+
+	head = gethead(state, PRVT->cursor + 1);
+	h4 = gethash(head, PRVT->hashbits);
 	PREFETCH(&PRVT->mhlist[h4]);
 	hash[0] = h4;
 
 	chain = PRVT->maxchain;
-	for (limit = (int16) (position4 - WNDWSIZE); chain != 0; chain--) {
+	for (limit = (TPosition) (position4 - WNDWSIZE); chain != 0; chain--) {
 		if (next4 <= limit) {
 			break;
 		}
@@ -2380,7 +5074,7 @@ getmatch1(struct TDEFLTPrvt* state, uint32 length, uint32 hash[1])
 		if (strbgn[length] == pmatch[length]) {
 			uint32 n;
 
-			n = getmatchlength(strbgn, pmatch);
+			n = getmatchlength(PRVT, strbgn, pmatch);
 			if (n > length) {
 				length = n;
 				offset = pmatch;
@@ -2393,6 +5087,7 @@ getmatch1(struct TDEFLTPrvt* state, uint32 length, uint32 hash[1])
 		next4 = PRVT->mchain[(uint32) next4 & CMASK];
 	}
 
+L1:
 	if (strbgn + length > strend) {
 		length -= (uint32) ((strbgn + length) - strend);
 	}
@@ -2410,20 +5105,32 @@ skipbytes1(struct TDEFLTPrvt* state, uintxx skip, uintxx total, uint32 hash[1])
 	for (; skip < total; skip++) {
 		PRVT->cursor++;
 
-		position4 = (uint16) (PRVT->cursor - PRVT->whence4);
-		if (CTB_EXPECT0(position4 == WNDWSIZE)) {
+		position4 = (TUPosition) (PRVT->cursor - PRVT->whence4);
+		if (CTB_EXPECT0(position4 == REBASEPOINT)) {
 			slidehash(state);
-			PRVT->whence4 += WNDWSIZE;
+			PRVT->whence4 += REBASEPOINT;
 			position4 = 0;
 		}
 
+		if (PRVT->buckets) {
+			bucketinsert(state, h4, position4);
+
+			hs = gethead(state, PRVT->cursor + 1);
+			h4 = gethash(hs, BBITS + 8);
+			continue;
+		}
 		PRVT->mchain[position4 & CMASK] = PRVT->mhlist[h4];
-		PRVT->mhlist[h4] = (int16) position4;
+		PRVT->mhlist[h4] = (TPosition) position4;
 
 		hs = gethead(state, PRVT->cursor + 1);
-		h4 = gethash(hs, HBITS);
+		h4 = gethash(hs, PRVT->hashbits);
+	}
+	if (PRVT->buckets) {
+		PREFETCH(&PRVT->buckets[h4 >> 8]);
+	}
+	else {
+		PREFETCH(&PRVT->mhlist[h4]);
 	}
-	PREFETCH(&PRVT->mhlist[h4]);
 	hash[0] = h4;
 }
 
@@ -2440,6 +5147,9 @@ compress1(struct TDEFLTPrvt* state)
 
 	if (PRVT->blockinit == 0) {
 		resetfreqs(state);
+		if (PRVT->splitter) {
+			resetsplitter(state);
+		}
 
 		PRVT->blockinit = 1;
 	}
@@ -2469,6 +5179,23 @@ L_LOOP:
 		}
 	}
 
+	if (PRVT->rawmode) {
+		if (passthrough(state, limit)) {
+			if (PRVT->rawmode == 0) {
+				uint32 head;
+
+				head = gethead(state, PRVT->cursor);
+				if (PRVT->buckets) {
+					hash[0] = gethash(head, BBITS + 8);
+				}
+				else {
+					hash[0] = gethash(head, PRVT->hashbits);
+				}
+			}
+			goto L_FLUSH;
+		}
+	}
+
 	while (limit > PRVT->cursor) {
 		struct TMatch match;
 
@@ -2481,9 +5208,10 @@ L_LOOP:
 			dsymbol = getdsymbol(match.offset);
 			lnsfrqs[lsymbol]++;
 			dstfrqs[dsymbol]++;
-			addmatch(state, match, lsymbol, dsymbol);
+			addmatch(state, match, dsymbol);
 
 			skipbytes1(state, 1, match.length, hash);
+			PRVT->pbmatch += match.length;
 		}
 		else {
 			uintxx c;
@@ -2494,13 +5222,28 @@ L_LOOP:
 		}
 
 		PRVT->cursor++;
-		if (CTB_EXPECT0(PRVT->zend + 4 > PRVT->lzlistend)) {
-			/* flush */
-			SETSTATE(1);
+		if (CTB_EXPECT0(PRVT->zend + 2 > PRVT->lzlistend)) {
+			goto L_FLUSH;
+		}
+		if (CTB_EXPECT0(PRVT->cursor >= PRVT->pbend)) {
+			if (probe(state)) {
+				goto L_FLUSH;
+			}
+		}
 
-			PRVT->aux4 = hash[0];
-			PRVT->hasinput = 1;
-			return 0;
+		if (PRVT->splitter) {
+			uintxx n;
+
+			n = (uintxx) (PRVT->zend - PRVT->lzlist);
+			if (CTB_EXPECT0(n >= PRVT->splitter->mark + SPLITSPAN)) {
+				if (splitblock(state)) {
+					SETSTATE(1);
+
+					PRVT->aux4 = hash[0];
+					PRVT->hasinput = 1;
+					return 0;
+				}
+			}
 		}
 	}
 
@@ -2513,10 +5256,23 @@ L_LOOP:
 	if (PBLC->flush) {
 		SETSTATE(1);
 		PRVT->hasinput = 0;
+		if (PRVT->splitter) {
+			PRVT->hasinput = splitblock(state);
+		}
 		/* no more input */
 		return 0;
 	}
 	return DEFLT_SRCEXHSTD;
+
+L_FLUSH:
+	SETSTATE(1);
+	if (PRVT->splitter) {
+		splitblock(state);
+	}
+
+	PRVT->aux4 = hash[0];
+	PRVT->hasinput = 1;
+	return 0;
 }
 
 
@@ -2615,9 +5371,9 @@ getmatch2(struct TDEFLTPrvt* state, uint32 length, uint32 hash[2], bool shrt)
 	uint32 head;
 	uint32 h3;
 	uint32 h4;
-	int16 next4;
+	TPosition next4;
 	uint16 next3;
-	int16 limit;
+	TPosition limit;
 
 	strbgn = strend = PRVT->window + PRVT->cursor;
 	strend = strend + MAXMATCH;
@@ -2626,33 +5382,42 @@ getmatch2(struct TDEFLTPrvt* state, uint32 length, uint32 hash[2], bool shrt)
 	}
 	offset = strbgn;
 
-	position4 = (uint16) (PRVT->cursor - PRVT->whence4);
+	position4 = (TUPosition) (PRVT->cursor - PRVT->whence4);
 	position3 = (uint16) (PRVT->cursor - PRVT->whence3);
-	if (CTB_EXPECT0(position4 == WNDWSIZE)) {
+	if (CTB_EXPECT0(position4 == REBASEPOINT)) {
 		slidehash(state);
-		PRVT->whence4 += WNDWSIZE;
+		PRVT->whence4 += REBASEPOINT;
 		position4 = 0;
 	}
 	h3 = hash[0];
 	h4 = hash[1];
 	next3 = PRVT->shlist[h3];
-	next4 = (int16) PRVT->mhlist[h4];
-
-	PRVT->mchain[position4 & CMASK] = PRVT->mhlist[h4];
-	PRVT->mhlist[h4] = ( int16) position4;
 	PRVT->schain[position3 & QMASK] = PRVT->shlist[h3];
 	PRVT->shlist[h3] = (uint16) position3;
 
 	head = gethead(state, PRVT->cursor + 1);
 	hash[0] = gethash(head >> 010, QBITS);
-	hash[1] = gethash(head >> 000, HBITS);
+	hash[1] = gethash(head >> 000, PRVT->hashbits);
 
 	chain = PRVT->maxchain;
 	if (length >= 3) {
 		chain = chain >> 1;
 	}
 
-	for (limit = (int16) (position4 - WNDWSIZE); chain != 0; chain--) {
+	if (PRVT->btree) {
+		length = btsearch(state, strbgn, position4, h4, length,
+			(uint32) (strend - strbgn), chain, &offset, NULL, NULL);
+		if (length >= PRVT->nicelength) {
+			goto L_L1;
+		}
+		goto L_L2;
+	}
+
+	next4 = PRVT->mhlist[h4];
+	PRVT->mchain[position4 & CMASK] = PRVT->mhlist[h4];
+	PRVT->mhlist[h4] = (TPosition) position4;
+
+	for (limit = (TPosition) (position4 - WNDWSIZE); chain != 0; chain--) {
 		if (next4 <= limit) {
 			break;
 		}
@@ -2661,7 +5426,7 @@ getmatch2(struct TDEFLTPrvt* state, uint32 length, uint32 hash[2], bool shrt)
 		if (strbgn[length] == pmatch[length]) {
 			uint32 n;
 
-			n = getmatchlength(strbgn, pmatch);
+			n = getmatchlength(PRVT, strbgn, pmatch);
 			if (n > length) {
 				length = n;
 				offset = pmatch;
@@ -2670,9 +5435,10 @@ getmatch2(struct TDEFLTPrvt* state, uint32 length, uint32 hash[2], bool shrt)
 				}
 			}
 		}
-		next4 = (int16) PRVT->mchain[(uint32) next4 & CMASK];
+		next4 = PRVT->mchain[(uint32) next4 & CMASK];
 	}
 
+L_L2:
 	if (CTB_EXPECT0(shrt && length < 3)) {
 		uint32 s1;
 		uintxx noffset;
@@ -2740,22 +5506,37 @@ skipbytes2(struct TDEFLTPrvt* state, uintxx skip, uintxx total, uint32 hash[2])
 	for (; skip < total; skip++) {
 		PRVT->cursor++;
 
-		position4 = (uint16) (PRVT->cursor - PRVT->whence4);
+		position4 = (TUPosition) (PRVT->cursor - PRVT->whence4);
 		position3 = (uint16) (PRVT->cursor - PRVT->whence3);
-		if (CTB_EXPECT0(position4 == WNDWSIZE)) {
+		if (CTB_EXPECT0(position4 == REBASEPOINT)) {
 			slidehash(state);
-			PRVT->whence4 += WNDWSIZE;
+			PRVT->whence4 += REBASEPOINT;
 			position4 = 0;
 		}
 
-		PRVT->mchain[position4 & CMASK] = PRVT->mhlist[h4];
-		PRVT->mhlist[h4] = ( int16) position4;
+		if (PRVT->btree) {
+			uint8* strbgn;
+			uint8* offset;
+			uint32 maxlength;
+
+			strbgn = PRVT->window + PRVT->cursor;
+			maxlength = MAXMATCH;
+			if (strbgn + maxlength > PRVT->inputend) {
+				maxlength = (uint32) (PRVT->inputend - strbgn);
+			}
+			btsearch(state, strbgn, position4, h4, MAXMATCH, maxlength,
+				PRVT->maxchain >> 1, &offset, NULL, NULL);
+		}
+		else {
+			PRVT->mchain[position4 & CMASK] = PRVT->mhlist[h4];
+			PRVT->mhlist[h4] = (TPosition) position4;
+		}
 		PRVT->schain[position3 & QMASK] = PRVT->shlist[h3];
 		PRVT->shlist[h3] = (uint16) position3;
 
 		hs = gethead(state, PRVT->cursor + 1);
 		h3 = gethash(hs >> 010, QBITS);
-		h4 = gethash(hs >> 000, HBITS);
+		h4 = gethash(hs >> 000, PRVT->hashbits);
 	}
 	PREFETCH(&PRVT->shlist[h3]);
 	PREFETCH(&PRVT->mhlist[h4]);
@@ -2783,6 +5564,9 @@ compress2(struct TDEFLTPrvt* state)
 	if (PRVT->blockinit == 0) {
 		resetfreqs(state);
 		resetobservations(stats);
+		if (PRVT->splitter) {
+			resetsplitter(state);
+		}
 
 		PRVT->blockinit = 1;
 	}
@@ -2800,6 +5584,9 @@ compress2(struct TDEFLTPrvt* state)
 		hasmatch = 1;
 	}
 	doshortmatches = PRVT->aux6;
+	if (PRVT->shortmode) {
+		doshortmatches = PRVT->shortmode == DEFLT_PENABLE;
+	}
 	hash[0] = (uint32) PRVT->aux3;
 	hash[1] = (uint32) PRVT->aux4;
 
@@ -2823,6 +5610,19 @@ L_LOOP:
 		}
 	}
 
+	if (PRVT->rawmode) {
+		if (passthrough(state, limit)) {
+			if (PRVT->rawmode == 0) {
+				uint32 head;
+
+				head = gethead(state, PRVT->cursor);
+				hash[0] = gethash(head >> 010, QBITS);
+				hash[1] = gethash(head >> 000, PRVT->hashbits);
+			}
+			goto L_FLUSH;
+		}
+	}
+
 	while (limit > PRVT->cursor) {
 		if (hasmatch == 0) {
 			match = getmatch2(state, MINMATCH - 1, hash, doshortmatches);
@@ -2841,8 +5641,9 @@ L_LOOP:
 					dstfrqs[dsymbol]++;
 					skipbytes2(state, 1, match.length, hash);
 
-					addmatch(state, match, lsymbol, dsymbol);
+					addmatch(state, match, dsymbol);
 					obsmatch(stats, match, lsymbol);
+					PRVT->pbmatch += match.length;
 				}
 				else {
 					hasmatch = 1;
@@ -2900,50 +5701,40 @@ L_LOOP:
 				dstfrqs[dsymbol]++;
 				skipbytes2(state, 2, prevm.length, hash);
 
-				addmatch(state, prevm, lsymbol, dsymbol);
+				addmatch(state, prevm, dsymbol);
 				obsmatch(stats, prevm, lsymbol);
+				PRVT->pbmatch += prevm.length;
 				hasmatch = 0;
 			}
 		}
 
 		PRVT->cursor++;
-		if (CTB_EXPECT0(PRVT->zend + 4 > PRVT->lzlistend)) {
-			/* flush */
-			SETSTATE(1);
-			resetobservations(stats);
-
-			PRVT->aux3 = hash[0];
-			PRVT->aux4 = hash[1];
-			PRVT->aux5 = 0;
-			if (hasmatch) {
-				PRVT->aux5 |= match.length << 0x00;
-				PRVT->aux5 |= match.offset << 0x10;
+		if (CTB_EXPECT0(PRVT->zend + 2 > PRVT->lzlistend)) {
+			goto L_FLUSH;
+		}
+		if (CTB_EXPECT0(PRVT->cursor >= PRVT->pbend) && hasmatch == 0) {
+			if (probe(state)) {
+				goto L_FLUSH;
 			}
-			PRVT->aux6 = doshortmatches;
-			PRVT->hasinput = 1;
-			return 0;
 		}
 
 		if (CTB_EXPECT0(stats->newcount >= 512 && stats->obstotal >= 4096)) {
-			if (stats->currobs[0] >= 16) {
-				doshortmatches = 1;
+			if (PRVT->shortmode == DEFLT_PDEFAULT) {
+				doshortmatches = stats->currobs[0] >= 16;
 			}
-			else {
-				doshortmatches = 0;
+			if (shouldsplit(stats) && PRVT->splitter == NULL) {
+				goto L_SPLIT;
 			}
-			if (shouldsplit(stats)) {
-				SETSTATE(1);
+		}
 
-				PRVT->aux3 = hash[0];
-				PRVT->aux4 = hash[1];
-				PRVT->aux5 = 0;
-				if (hasmatch) {
-					PRVT->aux5 |= match.length << 0x00;
-					PRVT->aux5 |= match.offset << 0x10;
+		if (PRVT->splitter) {
+			uintxx n;
+
+			n = (uintxx) (PRVT->zend - PRVT->lzlist);
+			if (CTB_EXPECT0(n >= PRVT->splitter->mark + SPLITSPAN)) {
+				if (splitblock(state)) {
+					goto L_SPLIT;
 				}
-				PRVT->aux6 = doshortmatches;
-				PRVT->hasinput = 1;
-				return 0;
 			}
 		}
 	}
@@ -2966,13 +5757,536 @@ L_LOOP:
 	if (PBLC->flush) {
 		SETSTATE(1);
 		PRVT->hasinput = 0;
+		if (PRVT->splitter) {
+			PRVT->hasinput = splitblock(state);
+		}
 		/* no more input */
 		return 0;
 	}
 	return DEFLT_SRCEXHSTD;
+
+L_FLUSH:
+	resetobservations(stats);
+	if (PRVT->splitter) {
+		splitblock(state);
+	}
+
+L_SPLIT:
+	SETSTATE(1);
+
+	PRVT->aux3 = hash[0];
+	PRVT->aux4 = hash[1];
+	PRVT->aux5 = 0;
+	if (hasmatch) {
+		PRVT->aux5 |= match.length << 0x00;
+		PRVT->aux5 |= match.offset << 0x10;
+	}
+	PRVT->aux6 = doshortmatches;
+	PRVT->hasinput = 1;
+	return 0;
+}
+
+/* ***************************************************************************
+ * Optimal parser (level 10 11 12)
+ *************************************************************************** */
+
+/* Cost of the symbols that were not used in the previous pass */
+#define OPTLNOSTAT 13
+#define OPTDNOSTAT 10
+
+/* Estimated cost of the header of a dynamic block */
+#define OPTHEADERBITS 600
+
+CTB_FORCEINLINE uintxx
+getmatches3(struct TDEFLTPrvt* state, uint32 hash[2], struct TOptMatch* m)
+{
+	uint8* strbgn;
+	uint8* pmatch;
+	uint32 length;
+	uint32 maxlength;
+	uint32 position4;
+	uint32 position3;
+	uint32 head;
+	uint32 h3;
+	uint32 h4;
+	uint16 next3;
+	uintxx noffset;
+	uintxx n;
+
+	strbgn = PRVT->window + PRVT->cursor;
+	maxlength = MAXMATCH;
+	if (strbgn + maxlength > PRVT->inputend) {
+		maxlength = (uint32) (PRVT->inputend - strbgn);
+	}
+
+	position4 = (TUPosition) (PRVT->cursor - PRVT->whence4);
+	position3 = (uint16) (PRVT->cursor - PRVT->whence3);
+	if (CTB_EXPECT0(position4 == REBASEPOINT)) {
+		slidehash(state);
+		PRVT->whence4 += REBASEPOINT;
+		position4 = 0;
+	}
+	h3 = hash[0];
+	h4 = hash[1];
+	next3 = PRVT->shlist[h3];
+
+	PRVT->schain[position3 & QMASK] = PRVT->shlist[h3];
+	PRVT->shlist[h3] = (uint16) position3;
+
+	head = gethead(state, PRVT->cursor + 1);
+	hash[0] = gethash(head >> 010, QBITS);
+	hash[1] = gethash(head >> 000, PRVT->hashbits);
+	PREFETCH(&PRVT->shlist[hash[0]]);
+	PREFETCH(&PRVT->mhlist[hash[1]]);
+
+	n = 0;
+	length = MINMATCH - 1;
+
+	/* the nearest 3 bytes match */
+	noffset = (uint16) (position3 - next3);
+	if (PRVT->shortmode == DEFLT_PDISABLE) {
+		noffset = 0;
+	}
+	if (maxlength >= MINMATCH && next3 && noffset && noffset <= WNDWSIZE) {
+		pmatch = strbgn - noffset;
+		if (pmatch[0] == strbgn[0] &&
+			pmatch[1] == strbgn[1] &&
+			pmatch[2] == strbgn[2]) {
+			length = MINMATCH;
+			m[n].length = (uint16) length;
+			m[n].offset = (uint16) noffset;
+			n++;
+		}
+	}
+
+	/* every match longer than the previous one */
+	btsearch(state, strbgn, position4, h4, length, maxlength, PRVT->maxchain,
+		&pmatch, m, &n);
+	return n;
 }
 
+static void
+setcosts(struct TDEFLTPrvt* state, bool initial)
+{
+	uintxx i;
+	uintxx n;
+	struct TDEFLTPrvt3* p3;
+	struct TDEFLTExtra* e;
+
+	p3 = PRVT->oparser;
+	e  = PRVT->extra;
+	for (i = 0; i < MAXLTCODES; i++) {
+		n = initial ? slitcodes[i].length : e->lfrqs[i];
+		if (n == 0) {
+			n = OPTLNOSTAT;
+		}
+		p3->litcost[i] = (uint32) n;
+	}
+
+	for (i = 0; i < MAXLZCODES; i++) {
+		n = 0;
+		if (initial) {
+			n = slnscodes[i].length;
+		}
+		else {
+			if (MAXLTCODES + i < DEFLT_LMAXSYMBOL) {
+				n = e->lfrqs[MAXLTCODES + i];
+			}
+		}
+		if (n == 0) {
+			n = OPTLNOSTAT;
+		}
+		p3->lnscost[i] = (uint32) n + slnscodes[i].extra;
+
+		n = initial ? sdstcodes[i].length : e->dfrqs[i];
+		if (n == 0) {
+			n = OPTDNOSTAT;
+		}
+		p3->dstcost[i] = (uint32) n + sdstcodes[i].extra;
+	}
+}
+
+/* Finds the cheapest path from the segment start to the segment end using the
+ * current costs */
+static void
+findpath(struct TDEFLTPrvt* state, const uint8* buffer, uintxx total)
+{
+	uintxx i;
+	uintxx j;
+	uintxx n;
+	uint32 length;
+	uint32 best;
+	struct TOptMatch choice;
+	struct TOptMatch* m;
+	struct TDEFLTPrvt3* p3;
+
+	p3 = PRVT->oparser;
+	m  = p3->cache + PRVT->aux6;
+
+	p3->costs[total] = 0;
+	for (i = total; i--;) {
+		best = p3->litcost[buffer[i]] + p3->costs[i + 1];
+		choice.length = 1;
+		choice.offset = 0;
+
+		n = p3->counts[i];
+		m = m - n;
+		if (n) {
+			uint32 maxlength;
+
+			maxlength = (uint32) (total - i);
+			length = MINMATCH;
+			for (j = 0; j < n; j++) {
+				uint32 dcost;
+				uint32 mlength;
+				uint32 offset;
+
+				offset = m[j].offset;
+				dcost  = p3->dstcost[getdsymbol(offset)];
+
+				mlength = m[j].length;
+				if (mlength > maxlength) {
+					mlength = maxlength;
+				}
+				for (; length <= mlength; length++) {
+					uint32 cost;
+
+					cost  = p3->lnscost[getlsymbol(length)];
+					cost += dcost + p3->costs[i + length];
+					if (cost < best) {
+						best = cost;
+						choice.length = (uint16) length;
+						choice.offset = (uint16) offset;
+					}
+				}
+			}
+		}
+		p3->costs[i] = best;
+		p3->path[i]  = choice;
+	}
+}
+
+/* Counts the symbol frequencies of the chosen path (including the ones of
+ * the previous segments of the block) and emits the tokens if emit is set */
+static void
+walkpath(struct TDEFLTPrvt* state, const uint8* buffer, uintxx total, bool emit)
+{
+	uintxx i;
+	uintxx* lnsfrqs;
+	uintxx* dstfrqs;
+	uintxx* litfrqs;
+	struct TOptMatch* path;
+
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		PRVT->extra->lfrqs[i] = PRVT->oparser->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		PRVT->extra->dfrqs[i] = PRVT->oparser->dfrqs[i];
+	}
+	litfrqs = PRVT->extra->lfrqs;
+	dstfrqs = PRVT->extra->dfrqs;
+	lnsfrqs = PRVT->extra->lfrqs + MAXLTCODES;
+
+	path = PRVT->oparser->path;
+	for (i = 0; i < total;) {
+		if (path[i].length == 1) {
+			uintxx c;
+
+			c = buffer[i];
+			litfrqs[c]++;
+			if (emit) {
+				addliteral(state, c);
+			}
+			i++;
+		}
+		else {
+			struct TMatch match;
+			uintxx lsymbol;
+			uintxx dsymbol;
+
+			match.length = path[i].length;
+			match.offset = path[i].offset;
+			lsymbol = getlsymbol(match.length);
+			dsymbol = getdsymbol(match.offset);
+			lnsfrqs[lsymbol]++;
+			dstfrqs[dsymbol]++;
+			if (emit) {
+				addmatch(state, match, dsymbol);
+			}
+			i += match.length;
+		}
+	}
+}
+
+CTB_INLINE void
+updatecosts(struct TDEFLTPrvt* state)
+{
+	/* get the code lengths the block would have */
+	PRVT->extra->lfrqs[BLOCKENDSYMBOL]++;
+	setuptable(PRVT->extra, LTABLEMODE, PRVT->extra->lfrqs);
+	setuptable(PRVT->extra, DTABLEMODE, PRVT->extra->dfrqs);
+	setcosts(state, 0);
+}
+
+/* Number of bits used by the literals, lengths and distances (the extra bits
+ * are not included) */
+static uintxx
+estimatebits(struct TDEFLTPrvt* state, const uintxx* lfrqs, const uintxx* dfrqs)
+{
+	uintxx i;
+	uintxx total;
+	struct TDEFLTExtra* e;
+
+	e = PRVT->extra;
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		e->lfrqs[i] = lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		e->dfrqs[i] = dfrqs[i];
+	}
+	e->lfrqs[BLOCKENDSYMBOL]++;
+	setuptable(e, LTABLEMODE, e->lfrqs);
+	setuptable(e, DTABLEMODE, e->dfrqs);
+
+	total = e->lfrqs[BLOCKENDSYMBOL];
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		total += lfrqs[i] * e->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		total += dfrqs[i] * e->dfrqs[i];
+	}
+	return total;
+}
+
+/* Checks if the segment should start a new block */
+static bool
+splitsegment(struct TDEFLTPrvt* state, const uint8* buffer, uintxx total)
+{
+	uintxx i;
+	uintxx joined;
+	uintxx splitted;
+	uintxx lfrqs[DEFLT_LMAXSYMBOL];
+	uintxx dfrqs[DEFLT_DMAXSYMBOL];
+	struct TDEFLTPrvt3* p3;
+
+	p3 = PRVT->oparser;
+	walkpath(state, buffer, total, 0);
+
+	/* segment frequencies */
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		lfrqs[i] = PRVT->extra->lfrqs[i] - p3->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		dfrqs[i] = PRVT->extra->dfrqs[i] - p3->dfrqs[i];
+	}
+	splitted = estimatebits(state, lfrqs, dfrqs) + OPTHEADERBITS;
+	splitted = estimatebits(state, p3->lfrqs, p3->dfrqs) + splitted;
+
+	/* block and segment frequencies */
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		lfrqs[i] += p3->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		dfrqs[i] += p3->dfrqs[i];
+	}
+	joined = estimatebits(state, lfrqs, dfrqs);
+	return splitted < joined;
+}
+
+/* Parses the segment and emits its tokens, returns zero if the segment should
+ * go in a new block (in that case nothing is emitted) */
+static bool
+optimalparse(struct TDEFLTPrvt* state, uintxx total)
+{
+	uintxx i;
+	uint32 pass;
+	bool isempty;
+	const uint8* buffer;
+	struct TDEFLTPrvt3* p3;
+
+	p3 = PRVT->oparser;
+	buffer = PRVT->window + (PRVT->cursor - total);
+
+	isempty = PRVT->zend == PRVT->lzlist;
+	if (isempty) {
+		setcosts(state, 1);
+	}
+	else {
+		/* use the statistics of the previous segments */
+		for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+			PRVT->extra->lfrqs[i] = p3->lfrqs[i];
+		}
+		for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+			PRVT->extra->dfrqs[i] = p3->dfrqs[i];
+		}
+		updatecosts(state);
+	}
+
+	for (pass = 1; pass < PRVT->passes; pass++) {
+		findpath(state, buffer, total);
+		walkpath(state, buffer, total, 0);
+		updatecosts(state);
+	}
+
+	findpath(state, buffer, total);
+	if (isempty == 0 && splitsegment(state, buffer, total)) {
+		/* restore the block frequencies */
+		for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+			PRVT->extra->lfrqs[i] = p3->lfrqs[i];
+		}
+		for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+			PRVT->extra->dfrqs[i] = p3->dfrqs[i];
+		}
+		return 0;
+	}
+	walkpath(state, buffer, total, 1);
+
+	for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+		p3->lfrqs[i] = PRVT->extra->lfrqs[i];
+	}
+	for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+		p3->dfrqs[i] = PRVT->extra->dfrqs[i];
+	}
+	return 1;
+}
+
+static uint32
+compress3(struct TDEFLTPrvt* state)
+{
+	uintxx limit;
+	uintxx srcleft;
+	uintxx r;
+	uintxx i;
+	struct TDEFLTPrvt3* p3;
+	uint32 hash[2];
+
+	p3 = PRVT->oparser;
+	if (PRVT->blockinit == 0) {
+		for (i = 0; DEFLT_LMAXSYMBOL > i; i++) {
+			p3->lfrqs[i] = 0;
+		}
+		for (i = 0; DEFLT_DMAXSYMBOL > i; i++) {
+			p3->dfrqs[i] = 0;
+		}
+		resetfreqs(state);
+
+		PRVT->blockinit = 1;
+	}
+	hash[0] = (uint32) PRVT->aux3;
+	hash[1] = (uint32) PRVT->aux4;
+
+L_LOOP:
+	limit = (uintxx) (PRVT->inputend - PRVT->window);
+	if (limit - PRVT->cursor > MINLOOKAHEAD + 1) {
+		srcleft = (uintxx) (PBLC->send - PBLC->source);
+		if (PBLC->flush == 0 || srcleft) {
+			limit -= MINLOOKAHEAD;
+		}
+	}
+	else {
+		srcleft = (uintxx) (PBLC->send - PBLC->source);
+		if (srcleft) {
+			limit = PRVT->cursor;
+		}
+		else {
+			if (PBLC->flush == 0) {
+				PRVT->aux3 = hash[0];
+				PRVT->aux4 = hash[1];
+				return DEFLT_SRCEXHSTD;
+			}
+		}
+	}
+
+	/* aux5 and aux6 are the number of positions and matches in the
+	 * segment */
+	while (limit > PRVT->cursor) {
+		struct TOptMatch* m;
+		uintxx n;
+
+		if (PRVT->aux5 == OPTSEGMENTSIZE) {
+			goto L_PARSE;
+		}
+		if (PRVT->aux6 + OPTMAXMATCHES > OPTCACHESIZE) {
+			goto L_PARSE;
+		}
+
+		m = p3->cache + PRVT->aux6;
+		n = getmatches3(state, hash, m);
+		p3->counts[PRVT->aux5++] = (uint8) n;
+		PRVT->aux6 += n;
+
+		if (n && m[n - 1].length >= PRVT->nicelength) {
+			uintxx skip;
+
+			/* don't search inside long matches */
+			skip = m[n - 1].length - 1u;
+			if (skip > OPTSEGMENTSIZE - PRVT->aux5) {
+				skip = OPTSEGMENTSIZE - PRVT->aux5;
+			}
+			skipbytes2(state, 0, skip, hash);
+			for (; skip; skip--) {
+				p3->counts[PRVT->aux5++] = 0;
+			}
+		}
+		PRVT->cursor++;
+	}
+
+	r = fillwindow(state);
+	if (r) {
+		goto L_LOOP;
+	}
+
+	PRVT->aux3 = hash[0];
+	PRVT->aux4 = hash[1];
+	if (PBLC->flush) {
+		if (PRVT->aux5) {
+			if (optimalparse(state, PRVT->aux5) == 0) {
+				/* end the current block, the segment is still pending */
+				SETSTATE(1);
+				PRVT->hasinput = 1;
+				return 0;
+			}
+		}
+		PRVT->aux5 = 0;
+		PRVT->aux6 = 0;
+
+		SETSTATE(1);
+		PRVT->hasinput = 0;
+		/* no more input */
+		return 0;
+	}
+	return DEFLT_SRCEXHSTD;
+
+L_PARSE:
+	if (optimalparse(state, PRVT->aux5) == 0) {
+		SETSTATE(1);
+		PRVT->aux3 = hash[0];
+		PRVT->aux4 = hash[1];
+		PRVT->hasinput = 1;
+		return 0;
+	}
+	PRVT->aux5 = 0;
+	PRVT->aux6 = 0;
+
+	/* we need space for a whole segment plus the end of block symbol */
+	if ((uintxx) (PRVT->lzlistend - PRVT->zend) > OPTSEGMENTSIZE + 1) {
+		goto L_LOOP;
+	}
+
+	SETSTATE(1);
+	PRVT->aux3 = hash[0];
+	PRVT->aux4 = hash[1];
+	PRVT->hasinput = 1;
+	return 0;
+}
+
+#undef OPTLNOSTAT
+#undef OPTDNOSTAT
+#undef OPTHEADERBITS
+
+
 #undef PREFETCH
+#undef SPLITSPAN
 #undef MINLOOKAHEAD
 
 #undef SETSTATE
@@ -68,6 +68,21 @@
  * to 32768 + 258 + 32 */
 #define WNDWSIZE 34816
 
+/* x86-64 SSE2 match copy (always present on x86-64) */
+#if defined(__SSE2__) || defined(_M_X64)
+	#if defined(__GNUC__) || defined(__MSVC__)
+		#define INFLT_SIMDCOPY
+	#endif
+#endif
+
+/* x86-64 BMI2 and AVX2 variant of decodefast (bzhi, shrx and the AVX2 match
+ * copy), selected at runtime */
+#if defined(INFLT_SIMDCOPY) && defined(__GNUC__)
+	#if defined(__x86_64__) || defined(__amd64__)
+		#define INFLT_AVX2DECODE
+	#endif
+#endif
+
 
 /* Private stuff */
 struct TINFLTPrvt {
@@ -132,6 +147,16 @@ struct TINFLTPrvt {
 	uintxx wndwend;
 	uintxx wndwcnt;
 
+	/* dictionary set with inflator_attachdctnr, it's not copied to the
+	 * window buffer so the offsets past wndwcnt are read from here */
+	const uint8* dctnr;
+	uintxx dctnrsize;
+
+#if defined(INFLT_AVX2DECODE)
+	/* decodefast variant for the CPU, selected by inflator_create */
+	uint32 (*decodefast)(struct TINFLTPrvt*);
+#endif
+
 	/* dynamic tables (trees) */
 	struct TTINFLTTables {
 		/* */
@@ -157,13 +182,20 @@ typedef union {
 #define PRVT ((struct TINFLTPrvt*) state)
 #define PBLC ((struct TINFLTPblc*) state)
 
+/* the window goes after the private struct */
+#define PRVTSIZE (sizeof(struct TINFLTPrvt) + WNDWSIZE + 32)
+
+#if defined(INFLT_AVX2DECODE)
+static void setdecodefast(struct TINFLTPrvt*);
+#endif
+
 TInflator*
 inflator_create(uintxx flags, const TAllocator* allctr)
 {
 	uintxx n;
 	struct TInflator* state;
 
-	n = sizeof(struct TINFLTPrvt) + WNDWSIZE + 32;
+	n = PRVTSIZE;
 	if (allctr == NULL) {
 		allctr = ctb_getdefaultallocator();
 		if (allctr == NULL) {
@@ -178,6 +210,9 @@ inflator_create(uintxx flags, const TAllocator* allctr)
 	PRVT->allctr = allctr;
 
     PRVT->tables = NULL;
+#if defined(INFLT_AVX2DECODE)
+	setdecodefast(PRVT);
+#endif
 	inflator_reset(state);
 	if (PBLC->error) {
 		inflator_destroy(state);
@@ -227,6 +262,9 @@ inflator_reset(TInflator* state)
 	PRVT->wndwend = 0;
 	PRVT->wndwcnt = 0;
 
+	PRVT->dctnr = NULL;
+	PRVT->dctnrsize = 0;
+
 	/* */
 	if (PRVT->tables == NULL) {
 		const struct TAllocator* a;
@@ -257,9 +295,17 @@ inflator_destroy(TInflator* state)
 	if (PRVT->tables) {
 		a->dispose(PRVT->tables, sizeof(struct TTINFLTTables), a->user);
 	}
-	a->dispose(PRVT, sizeof(struct TINFLTPrvt) + WNDWSIZE + 32, a->user);
+	a->dispose(PRVT, PRVTSIZE, a->user);
+}
+
+uintxx
+inflator_memusage(void)
+{
+	return PRVTSIZE + sizeof(struct TTINFLTTables);
 }
 
+#undef PRVTSIZE
+
 
 CTB_FORCEINLINE uint32
 reversecode(uint32 code, uintxx length)
@@ -318,16 +364,21 @@ reversecode(uint32 code, uintxx length)
 
 
 /* Tags for the table entries */
-#define TAG_LIT 0x80000000  /* literal */
+#define TAG_LIT 0x00008000  /* literal */
 #define TAG_END 0x00004000  /* end of block */
 #define TAG_SUB 0x00002000  /* subtable */
+#define TAG_TWO 0x00001000  /* two literals */
 
 
 /* Entry layout
- * Literals:
- * txxxxxxx vvvvvvvv xxxxxxxx xxxxllll
+ * Literals (a root entry can hold a second literal when both codes fit in
+ * the root bits, then llll is the length of both codes and ffff the length
+ * of the first one):
+ * wwwwwwww vvvvvvvv ttttffff xxxxllll
  * 
- * Length or distance (or subtable offset)
+ * Length or distance (or subtable offset), in the root table the entries
+ * whose code and extra bits fit in the root bits have the final value and
+ * the length of both (no extra bits):
  * vvvvvvvv vvvvvvvv tttteeee xxxxllll */
 
 #define DOENTRY(BASE, EXTRA) (((BASE) << 16) | ((EXTRA) << 8))
@@ -536,7 +587,7 @@ buildtable(uint16* lengths, uintxx n, uint32* table, uintxx mode)
 		else {
 			e = (uint32) symbol << 16;
 			if (mode == LTABLEMODE) {
-				e |= TAG_LIT;
+				e |= TAG_LIT | (uint32) (length << 8);
 			}
 		}
 		e |= (uint32) length;
@@ -555,8 +606,23 @@ buildtable(uint16* lengths, uintxx n, uint32* table, uintxx mode)
 			code  >>= mbits;
 		}
 		else {
+			uintxx extra;
+
 			j = (intxx) (mbits - length);
 			i = 0;
+
+			/* lengths and distances with the extra bits in the root bits
+			 * are stored resolved (the total bits and no extra bits) */
+			extra = (e >> 8) & 0x0f;
+			if (extra && (e & TAG_LIT) == 0 && length + extra <= mbits) {
+				e = (e & ~((uint32) 0x0f00)) + (uint32) extra;
+				for (j = (1l << j) - 1; j >= 0; j--) {
+					i = j & ((1l << extra) - 1);
+					table[code | ((uint32) j << length)] =
+						e + ((uint32) i << 16);
+				}
+				continue;
+			}
 		}
 
 		for (j = (1l << j) - 1; j >= 0; j--) {
@@ -564,6 +630,26 @@ buildtable(uint16* lengths, uintxx n, uint32* table, uintxx mode)
 		}
 	}
 
+	if (mode == LTABLEMODE) {
+		uint32 a;
+		uint32 b;
+
+		/* pair the literals whose codes fit together in the root bits, the
+		 * entries are visited backwards so the second code is always read
+		 * from an entry not paired yet */
+		for (i = (intxx) mmask; i >= 0; i--) {
+			a = table[i];
+			if ((a & TAG_LIT) == 0 || (uint8) a >= mbits) {
+				continue;
+			}
+
+			b = table[(uint32) i >> (uint8) a];
+			if ((b & TAG_LIT) == 0 || (uint8) a + (uint8) b > mbits) {
+				continue;
+			}
+			table[i] = a + ((b & 0x00ff0000) << 8) + (uint8) b + TAG_TWO;
+		}
+	}
 	return 0;
 }
 
@@ -924,6 +1010,27 @@ inflator_setdctnr(TInflator* state, const uint8* dict, uintxx size)
 	PRVT->used = 1;
 }
 
+void
+inflator_attachdctnr(TInflator* state, const uint8* dict, uintxx size)
+{
+	CTB_ASSERT(state && dict && size);
+
+	if (PRVT->used) {
+		SETERROR(INFLT_EINCORRECTUSE);
+		SETSTATE(0xDEADBEEF);
+		return;
+	}
+
+	if (size > DEFLT_WINDOWSIZE) {
+		dict = (dict + size) - DEFLT_WINDOWSIZE;
+		size = DEFLT_WINDOWSIZE;
+	}
+
+	PRVT->dctnr = dict;
+	PRVT->dctnrsize = size;
+	PRVT->used = 1;
+}
+
 
 #define slength PRVT->aux0
 
@@ -1232,17 +1339,24 @@ copybytes(struct TINFLTPrvt* state)
 		if (soffset > total) {
 			maxrun = soffset - total;
 			if (CTB_EXPECT0(maxrun > PRVT->wndwcnt)) {
-				SETERROR(INFLT_EFAROFFSET);
-				return INFLT_ERROR;
-			}
+				maxrun -= PRVT->wndwcnt;
+				if (CTB_EXPECT0(maxrun > PRVT->dctnrsize)) {
+					SETERROR(INFLT_EFAROFFSET);
+					return INFLT_ERROR;
+				}
 
-			buffer = PRVT->wndwbuffer;
-			if (maxrun > PRVT->wndwend) {
-				maxrun -= PRVT->wndwend;
-				buffer += WNDWSIZE - maxrun;
+				buffer = CTB_CONSTCAST(PRVT->dctnr);
+				buffer += PRVT->dctnrsize - maxrun;
 			}
 			else {
-				buffer += PRVT->wndwend - maxrun;
+				buffer = PRVT->wndwbuffer;
+				if (maxrun > PRVT->wndwend) {
+					maxrun -= PRVT->wndwend;
+					buffer += WNDWSIZE - maxrun;
+				}
+				else {
+					buffer += PRVT->wndwend - maxrun;
+				}
 			}
 
 			if (maxrun > slength)
@@ -1320,11 +1434,19 @@ copybytes(struct TINFLTPrvt* state)
 
 #define DROPBITS(BB, BC, N) (((BB) = (BB) >> (N)), ((BC) -= (N)))
 
+/* Write the literal (or the two literals) of an entry, the second byte is
+ * always stored */
+#define PUTLITERALS(T, E) \
+	(((T)[0] = (uint8) ((E) >> 0x10)), \
+	 ((T)[1] = (uint8) ((E) >> 0x18)), ((T) += 1 + (((E) >> 12) & 1)))
+
 
 #define FASTSRCLEFT  15
-#define FASTTGTLEFT 274
+#define FASTTGTLEFT 292
 
-static uint32 decodefast(struct TINFLTPrvt* state);
+#if !defined(INFLT_AVX2DECODE)
+static uint32 decodefast(struct TINFLTPrvt*);
+#endif
 
 static uint32
 decodeblock(struct TINFLTPrvt* state)
@@ -1361,7 +1483,11 @@ L_LOOP:
 			PRVT->bbuffer = bb;
 			PRVT->bcount  = bc;
 			
+#if defined(INFLT_AVX2DECODE)
+			r = PRVT->decodefast(PRVT);
+#else
 			r = decodefast(PRVT);
+#endif
 			if (r == 256) {
 				/* end of block */
 				PRVT->substate = 0;
@@ -1394,6 +1520,11 @@ L_LOOP:
 		e = PRVT->ltable[base + (MASKBITS(bb, (uint8) e) >> LROOTBITS)];
 	}
 
+	if (e & TAG_LIT) {
+		/* only the first literal of a pair is decoded here */
+		e = (e & 0x00ffff00) | ((e >> 8) & 0x0f);
+	}
+
 	if (or) {
 		bc -= or;
 		if (bc < (uint8) e) {
@@ -1526,8 +1657,234 @@ L_SRCEXHSTD:
 #endif
 
 
-static uint32
-decodefast(struct TINFLTPrvt* state)
+/* Copies a match that starts before the target buffer (from the window or
+ * the dictionary), it's kept out of decodefast to not take registers from
+ * the decode loop */
+static uint8*
+copyfar(struct TINFLTPrvt* state, uint8* target, uintxx offset, uintxx length)
+{
+	uint8* buffer;
+	uintxx maxrun;
+
+	maxrun = (uintxx) (target - PBLC->tbgn);
+	do {
+		if (CTB_EXPECT0(offset > maxrun)) {
+			maxrun = offset - maxrun;
+			if (CTB_EXPECT0(maxrun > PRVT->wndwcnt)) {
+				maxrun -= PRVT->wndwcnt;
+				if (CTB_EXPECT0(maxrun > PRVT->dctnrsize)) {
+					SETERROR(INFLT_EFAROFFSET);
+					return NULL;
+				}
+
+				buffer = CTB_CONSTCAST(PRVT->dctnr);
+				buffer += PRVT->dctnrsize - maxrun;
+			}
+			else {
+				buffer = PRVT->wndwbuffer;
+				if (maxrun > PRVT->wndwend) {
+					maxrun -= PRVT->wndwend;
+					buffer += WNDWSIZE - maxrun;
+				}
+				else {
+					buffer += PRVT->wndwend - maxrun;
+				}
+			}
+
+			if (maxrun > length)
+				maxrun = length;
+		}
+		else {
+			buffer = target - offset;
+			maxrun = length;
+		}
+
+		length -= maxrun;
+		if (CTB_EXPECT1(offset >= PLATFORMWORDSIZE)) {
+			for (;maxrun > 8; maxrun -= 8) {
+#if !defined(CTB_STRICTALIGNMENT) && defined(CTB_FASTUNALIGNED)
+#if defined(CTB_ENV64)
+				((uint64*) target)[0] = ((uint64*) buffer)[0];
+#else
+				((uint32*) target)[0] = ((uint32*) buffer)[0];
+				((uint32*) target)[1] = ((uint32*) buffer)[1];
+#endif
+#else
+				target[0] = buffer[0];
+				target[1] = buffer[1];
+				target[2] = buffer[2];
+				target[3] = buffer[3];
+				target[4] = buffer[4];
+				target[5] = buffer[5];
+				target[6] = buffer[6];
+				target[7] = buffer[7];
+#endif
+				target += 8;
+				buffer += 8;
+			}
+		}
+
+		while (maxrun--) {
+			*target++ = *buffer++;
+		}
+		maxrun = (uintxx) (target - PBLC->tbgn);
+	} while (length);
+	return target;
+}
+
+#if defined(INFLT_SIMDCOPY)
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wcast-align"
+#endif
+
+#define LOAD128(P) _mm_loadu_si128((const __m128i*) (P))
+#define LOAD256(P) _mm256_loadu_si256((const __m256i*) (P))
+
+#define STORE128(P, V) _mm_storeu_si128((__m128i*) (P), (V))
+#define STORE256(P, V) _mm256_storeu_si256((__m256i*) (P), (V))
+
+/* Copies a match inside the target buffer, the stores can go up to 15 bytes
+ * (31 with AVX2) past the end of the match, FASTTGTLEFT leaves room for it.
+ * When the offset is smaller than a vector the bytes of the offset are
+ * repeated to fill it and it's stored with a step that keeps the period */
+CTB_FORCEINLINE uint8*
+copynearsse2(uint8* target, uintxx offset, uintxx length)
+{
+	const uint8* buffer;
+	uint8* end;
+	__m128i v;
+
+	end = target + length;
+	buffer = target - offset;
+	if (CTB_EXPECT1(offset >= 16)) {
+		do {
+			STORE128(target, LOAD128(buffer));
+			target += 16;
+			buffer += 16;
+		} while (target < end);
+		return end;
+	}
+
+	v = LOAD128(buffer);
+	switch (offset) {
+		case 1: v = _mm_set1_epi8((char) buffer[0]); break;
+		case 2: v = _mm_set1_epi16((short) _mm_cvtsi128_si32(v)); break;
+		case 4: v = _mm_set1_epi32(_mm_cvtsi128_si32(v)); break;
+		case 8: v = _mm_unpacklo_epi64(v, v); break;
+		default:
+			/* only the first offset bytes of each store are right, the
+			 * rest is written again by the next one */
+			do {
+				STORE128(target, LOAD128(buffer));
+				target += offset;
+				buffer += offset;
+			} while (target < end);
+			return end;
+	}
+
+	do {
+		STORE128(target, v);
+		target += 16;
+	} while (target < end);
+	return end;
+}
+
+#if defined(INFLT_AVX2DECODE)
+
+/* Shuffle masks that repeat the first n bytes of a vector */
+static const uint8 ptrnmasks[16][16] = {
+	{ 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 },
+	{ 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+	{ 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0 },
+	{ 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 5, 6, 0, 1, 2, 3, 4, 5, 6, 0, 1 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 0, 1, 2, 3, 4, 5, 6 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 2, 3, 4, 5 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10, 0, 1, 2, 3, 4 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12, 0, 1, 2 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13, 0, 1 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14, 0 }
+};
+
+/* The largest multiple of the offset that fits in 16 bytes */
+static const uint8 ptrnsteps[16] = {
+	0, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15
+};
+
+__attribute__((target("avx2"))) CTB_INLINE uint8*
+copynearavx2(uint8* target, uintxx offset, uintxx length)
+{
+	const uint8* buffer;
+	uint8* end;
+	__m128i v;
+	uintxx step;
+
+	end = target + length;
+	buffer = target - offset;
+	if (CTB_EXPECT1(offset >= 32)) {
+		do {
+			STORE256(target, LOAD256(buffer));
+			target += 32;
+			buffer += 32;
+		} while (target < end);
+		return end;
+	}
+
+	if (offset >= 16) {
+		do {
+			STORE128(target, LOAD128(buffer));
+			target += 16;
+			buffer += 16;
+		} while (target < end);
+		return end;
+	}
+
+	/* the bytes past the offset are not part of the match yet, the shuffle
+	 * only takes the first offset bytes */
+	v = _mm_shuffle_epi8(LOAD128(buffer), LOAD128(ptrnmasks[offset]));
+	step = ptrnsteps[offset];
+	if (step == 16) {
+		__m256i w;
+
+		w = _mm256_broadcastsi128_si256(v);
+		do {
+			STORE256(target, w);
+			target += 32;
+		} while (target < end);
+		return end;
+	}
+
+	do {
+		STORE128(target, v);
+		target += step;
+	} while (target < end);
+	return end;
+}
+
+#endif
+
+#undef LOAD128
+#undef LOAD256
+#undef STORE128
+#undef STORE256
+
+#if defined(__clang__)
+	#pragma clang diagnostic pop
+#endif
+
+#endif
+
+CTB_FORCEINLINE uint32
+decodefastimpl(struct TINFLTPrvt* state, uintxx wide)
 {
 	uint32 r;
 	const uint8* source;
@@ -1554,6 +1911,9 @@ decodefast(struct TINFLTPrvt* state)
 	dtable = PRVT->dtable;
 	bb = PRVT->bbuffer;
 	bc = PRVT->bcount;
+#if !defined(INFLT_AVX2DECODE)
+	(void) wide;
+#endif
 
 	r = 0;
 	do {
@@ -1561,7 +1921,6 @@ decodefast(struct TINFLTPrvt* state)
 		uintxx offset;
 		uintxx extra;
 		uintxx targetbytes;
-		uintxx maxrun;
 		uint8* buffer;
 
 #if !defined(CTB_ENV64)
@@ -1579,7 +1938,7 @@ decodefast(struct TINFLTPrvt* state)
 		/* decode literal or length */
 		e = ltable[MASKBITS(bb, LROOTBITS)];
 		if (CTB_EXPECT1(e & TAG_LIT)) {
-			*target++ = (uint8) (e >> 0x10);
+			PUTLITERALS(target, e);
 			DROPBITS(bb, bc, (uint8) e);
 
 #if !defined(CTB_ENV64)
@@ -1587,7 +1946,7 @@ decodefast(struct TINFLTPrvt* state)
 #else
 			e = ltable[MASKBITS(bb, LROOTBITS)];
 			if (CTB_EXPECT1(e & TAG_LIT)) {
-				*target++ = (uint8) (e >> 0x10);
+				PUTLITERALS(target, e);
 				DROPBITS(bb, bc, (uint8) e);
 
 				e = ltable[MASKBITS(bb, LROOTBITS)];
@@ -1603,7 +1962,7 @@ decodefast(struct TINFLTPrvt* state)
 		}
 
 		if (CTB_EXPECT1(e & TAG_LIT)) {
-			*target++ = (uint8) (e >> 0x10);
+			PUTLITERALS(target, e);
 
 			DROPBITS(bb, bc, (uint8) e);
 			continue;
@@ -1624,16 +1983,19 @@ decodefast(struct TINFLTPrvt* state)
 		}
 		DROPBITS(bb, bc, (uint8) e);
 
+		length = e >> 0x10;
 		extra = (e >> 0x08) & 0x0f;
+		if (CTB_EXPECT0(extra)) {
 #if !defined(CTB_ENV64)
-		if (bc < extra) {
-			bb |= LOAD32(source) << bc;
-			source = (source + 3) - ((bc >> 3) & 0x07);
-			bc |= 24;
-		}
+			if (bc < extra) {
+				bb |= LOAD32(source) << bc;
+				source = (source + 3) - ((bc >> 3) & 0x07);
+				bc |= 24;
+			}
 #endif
-		length = (e >> 0x10) + (uintxx) MASKBITS(bb, extra);
-		DROPBITS(bb, bc, extra);
+			length += (uintxx) MASKBITS(bb, extra);
+			DROPBITS(bb, bc, extra);
+		}
 
 		/* distance */
 #if !defined(CTB_ENV64)
@@ -1658,26 +2020,39 @@ decodefast(struct TINFLTPrvt* state)
 		}
 		DROPBITS(bb, bc, (uint8) e);
 
+		offset = e >> 0x10;
 		extra = (e >> 0x08) & 0x0f;
+		if (CTB_EXPECT0(extra)) {
 #if !defined(CTB_ENV64)
-		if (bc < extra) {
-			bb |= LOAD32(source) << bc;
-			source = (source + 3) - ((bc >> 3) & 0x07);
-			bc |= 24;
-		}
+			if (bc < extra) {
+				bb |= LOAD32(source) << bc;
+				source = (source + 3) - ((bc >> 3) & 0x07);
+				bc |= 24;
+			}
 #else
-		if (bc < 13) {
-			bb |= LOAD64(source) << bc;
-			source = (source + 7) - ((bc >> 3) & 0x07);
-			bc |= 56;
-		}
+			if (bc < 13) {
+				bb |= LOAD64(source) << bc;
+				source = (source + 7) - ((bc >> 3) & 0x07);
+				bc |= 56;
+			}
 #endif
-		offset = (e >> 0x10) + (uintxx) MASKBITS(bb, extra);
-		DROPBITS(bb, bc, extra);
+			offset += (uintxx) MASKBITS(bb, extra);
+			DROPBITS(bb, bc, extra);
+		}
 
 		targetbytes = (uintxx) (target - PBLC->tbgn);
 		if (CTB_EXPECT0(offset < targetbytes)) {
+#if defined(INFLT_SIMDCOPY)
+#if defined(INFLT_AVX2DECODE)
+			if (wide) {
+				target = copynearavx2(target, offset, length);
+				continue;
+			}
+#endif
+			target = copynearsse2(target, offset, length);
+#else
 			uint8* end;
+			uintxx maxrun;
 
 			buffer = target - offset;
 			maxrun = length;
@@ -1751,64 +2126,15 @@ decodefast(struct TINFLTPrvt* state)
 					*target++ = *buffer++;
 				} while (target < end);
 			}
+#endif
 		}
 		else {
-			maxrun = targetbytes;
-			do {
-				if (CTB_EXPECT0(offset > maxrun)) {
-					maxrun = offset - maxrun;
-					if (CTB_EXPECT0(maxrun > PRVT->wndwcnt)) {
-						SETERROR(INFLT_EFAROFFSET);
-						return INFLT_ERROR;
-					}
-
-					buffer = PRVT->wndwbuffer;
-					if (maxrun > PRVT->wndwend) {
-						maxrun -= PRVT->wndwend;
-						buffer += WNDWSIZE - maxrun;
-					}
-					else {
-						buffer += PRVT->wndwend - maxrun;
-					}
-
-					if (maxrun > length)
-						maxrun = length;
-				}
-				else {
-					buffer = target - offset;
-					maxrun = length;
-				}
-
-				length -= maxrun;
-				if (CTB_EXPECT1(offset >= PLATFORMWORDSIZE)) {
-					for (;maxrun > 8; maxrun -= 8) {
-#if !defined(CTB_STRICTALIGNMENT) && defined(CTB_FASTUNALIGNED)
-#if defined(CTB_ENV64)
-						((uint64*) target)[0] = ((uint64*) buffer)[0];
-#else
-						((uint32*) target)[0] = ((uint32*) buffer)[0];
-						((uint32*) target)[1] = ((uint32*) buffer)[1];
-#endif
-#else
-						target[0] = buffer[0];
-						target[1] = buffer[1];
-						target[2] = buffer[2];
-						target[3] = buffer[3];
-						target[4] = buffer[4];
-						target[5] = buffer[5];
-						target[6] = buffer[6];
-						target[7] = buffer[7];
-#endif
-						target += 8;
-						buffer += 8;
-					}
-				}
-
-				while (maxrun--) {
-					*target++ = *buffer++;
-				}
-				maxrun = (uintxx) (target - PBLC->tbgn);
-			} while (length);
+			buffer = copyfar(PRVT, target, offset, length);
+			if (CTB_EXPECT0(buffer == NULL)) {
+				r = INFLT_ERROR;
+				break;
+			}
+			target = buffer;
 		}
 	} while (tend > target && send > source);
 
@@ -1822,6 +2148,47 @@ decodefast(struct TINFLTPrvt* state)
 	return r;
 }
 
+#if defined(INFLT_AVX2DECODE)
+
+static uint32
+decodefastbase(struct TINFLTPrvt* state)
+{
+	return decodefastimpl(state, 0);
+}
+
+__attribute__((target("bmi,bmi2,avx2"))) static uint32
+decodefastavx2(struct TINFLTPrvt* state)
+{
+	return decodefastimpl(state, 1);
+}
+
+static void
+setdecodefast(struct TINFLTPrvt* state)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("bmi") &&
+		__builtin_cpu_supports("bmi2") &&
+		__builtin_cpu_supports("avx2")) {
+		PRVT->decodefast = decodefastavx2;
+	}
+	else {
+		PRVT->decodefast = decodefastbase;
+	}
+}
+
+#else
+
+static uint32
+decodefast(struct TINFLTPrvt* state)
+{
+	return decodefastimpl(state, 0);
+}
+
+#endif
+
+#undef INFLT_AVX2DECODE
+#undef INFLT_SIMDCOPY
+
 #if defined(__clang__) && defined(CTB_FASTUNALIGNED)
 	#pragma clang diagnostic pop
 #endif
@@ -1838,329 +2205,329 @@ decodefast(struct TINFLTPrvt* state)
 #if LROOTBITS == 10 && DROOTBITS == 8
 
 static const uint32 lsttctable_[] = {
-	0x00004007, 0x80500008, 0x80100008, 0x00730408,
-	0x001f0207, 0x80700008, 0x80300008, 0x80c00009,
-	0x000a0007, 0x80600008, 0x80200008, 0x80a00009,
-	0x80000008, 0x80800008, 0x80400008, 0x80e00009,
-	0x00060007, 0x80580008, 0x80180008, 0x80900009,
-	0x003b0307, 0x80780008, 0x80380008, 0x80d00009,
-	0x00110107, 0x80680008, 0x80280008, 0x80b00009,
-	0x80080008, 0x80880008, 0x80480008, 0x80f00009,
-	0x00040007, 0x80540008, 0x80140008, 0x00e30508,
-	0x002b0307, 0x80740008, 0x80340008, 0x80c80009,
-	0x000d0107, 0x80640008, 0x80240008, 0x80a80009,
-	0x80040008, 0x80840008, 0x80440008, 0x80e80009,
-	0x00080007, 0x805c0008, 0x801c0008, 0x80980009,
-	0x00530407, 0x807c0008, 0x803c0008, 0x80d80009,
-	0x00170207, 0x806c0008, 0x802c0008, 0x80b80009,
-	0x800c0008, 0x808c0008, 0x804c0008, 0x80f80009,
-	0x00030007, 0x80520008, 0x80120008, 0x00a30508,
-	0x00230307, 0x80720008, 0x80320008, 0x80c40009,
-	0x000b0107, 0x80620008, 0x80220008, 0x80a40009,
-	0x80020008, 0x80820008, 0x80420008, 0x80e40009,
-	0x00070007, 0x805a0008, 0x801a0008, 0x80940009,
-	0x00430407, 0x807a0008, 0x803a0008, 0x80d40009,
-	0x00130207, 0x806a0008, 0x802a0008, 0x80b40009,
-	0x800a0008, 0x808a0008, 0x804a0008, 0x80f40009,
-	0x00050007, 0x80560008, 0x80160008, 0x00000008,
-	0x00330307, 0x80760008, 0x80360008, 0x80cc0009,
-	0x000f0107, 0x80660008, 0x80260008, 0x80ac0009,
-	0x80060008, 0x80860008, 0x80460008, 0x80ec0009,
-	0x00090007, 0x805e0008, 0x801e0008, 0x809c0009,
-	0x00630407, 0x807e0008, 0x803e0008, 0x80dc0009,
-	0x001b0207, 0x806e0008, 0x802e0008, 0x80bc0009,
-	0x800e0008, 0x808e0008, 0x804e0008, 0x80fc0009,
-	0x00004007, 0x80510008, 0x80110008, 0x00830508,
-	0x001f0207, 0x80710008, 0x80310008, 0x80c20009,
-	0x000a0007, 0x80610008, 0x80210008, 0x80a20009,
-	0x80010008, 0x80810008, 0x80410008, 0x80e20009,
-	0x00060007, 0x80590008, 0x80190008, 0x80920009,
-	0x003b0307, 0x80790008, 0x80390008, 0x80d20009,
-	0x00110107, 0x80690008, 0x80290008, 0x80b20009,
-	0x80090008, 0x80890008, 0x80490008, 0x80f20009,
-	0x00040007, 0x80550008, 0x80150008, 0x01020008,
-	0x002b0307, 0x80750008, 0x80350008, 0x80ca0009,
-	0x000d0107, 0x80650008, 0x80250008, 0x80aa0009,
-	0x80050008, 0x80850008, 0x80450008, 0x80ea0009,
-	0x00080007, 0x805d0008, 0x801d0008, 0x809a0009,
-	0x00530407, 0x807d0008, 0x803d0008, 0x80da0009,
-	0x00170207, 0x806d0008, 0x802d0008, 0x80ba0009,
-	0x800d0008, 0x808d0008, 0x804d0008, 0x80fa0009,
-	0x00030007, 0x80530008, 0x80130008, 0x00c30508,
-	0x00230307, 0x80730008, 0x80330008, 0x80c60009,
-	0x000b0107, 0x80630008, 0x80230008, 0x80a60009,
-	0x80030008, 0x80830008, 0x80430008, 0x80e60009,
-	0x00070007, 0x805b0008, 0x801b0008, 0x80960009,
-	0x00430407, 0x807b0008, 0x803b0008, 0x80d60009,
-	0x00130207, 0x806b0008, 0x802b0008, 0x80b60009,
-	0x800b0008, 0x808b0008, 0x804b0008, 0x80f60009,
-	0x00050007, 0x80570008, 0x80170008, 0x00000008,
-	0x00330307, 0x80770008, 0x80370008, 0x80ce0009,
-	0x000f0107, 0x80670008, 0x80270008, 0x80ae0009,
-	0x80070008, 0x80870008, 0x80470008, 0x80ee0009,
-	0x00090007, 0x805f0008, 0x801f0008, 0x809e0009,
-	0x00630407, 0x807f0008, 0x803f0008, 0x80de0009,
-	0x001b0207, 0x806f0008, 0x802f0008, 0x80be0009,
-	0x800f0008, 0x808f0008, 0x804f0008, 0x80fe0009,
-	0x00004007, 0x80500008, 0x80100008, 0x00730408,
-	0x001f0207, 0x80700008, 0x80300008, 0x80c10009,
-	0x000a0007, 0x80600008, 0x80200008, 0x80a10009,
-	0x80000008, 0x80800008, 0x80400008, 0x80e10009,
-	0x00060007, 0x80580008, 0x80180008, 0x80910009,
-	0x003b0307, 0x80780008, 0x80380008, 0x80d10009,
-	0x00110107, 0x80680008, 0x80280008, 0x80b10009,
-	0x80080008, 0x80880008, 0x80480008, 0x80f10009,
-	0x00040007, 0x80540008, 0x80140008, 0x00e30508,
-	0x002b0307, 0x80740008, 0x80340008, 0x80c90009,
-	0x000d0107, 0x80640008, 0x80240008, 0x80a90009,
-	0x80040008, 0x80840008, 0x80440008, 0x80e90009,
-	0x00080007, 0x805c0008, 0x801c0008, 0x80990009,
-	0x00530407, 0x807c0008, 0x803c0008, 0x80d90009,
-	0x00170207, 0x806c0008, 0x802c0008, 0x80b90009,
-	0x800c0008, 0x808c0008, 0x804c0008, 0x80f90009,
-	0x00030007, 0x80520008, 0x80120008, 0x00a30508,
-	0x00230307, 0x80720008, 0x80320008, 0x80c50009,
-	0x000b0107, 0x80620008, 0x80220008, 0x80a50009,
-	0x80020008, 0x80820008, 0x80420008, 0x80e50009,
-	0x00070007, 0x805a0008, 0x801a0008, 0x80950009,
-	0x00430407, 0x807a0008, 0x803a0008, 0x80d50009,
-	0x00130207, 0x806a0008, 0x802a0008, 0x80b50009,
-	0x800a0008, 0x808a0008, 0x804a0008, 0x80f50009,
-	0x00050007, 0x80560008, 0x80160008, 0x00000008,
-	0x00330307, 0x80760008, 0x80360008, 0x80cd0009,
-	0x000f0107, 0x80660008, 0x80260008, 0x80ad0009,
-	0x80060008, 0x80860008, 0x80460008, 0x80ed0009,
-	0x00090007, 0x805e0008, 0x801e0008, 0x809d0009,
-	0x00630407, 0x807e0008, 0x803e0008, 0x80dd0009,
-	0x001b0207, 0x806e0008, 0x802e0008, 0x80bd0009,
-	0x800e0008, 0x808e0008, 0x804e0008, 0x80fd0009,
-	0x00004007, 0x80510008, 0x80110008, 0x00830508,
-	0x001f0207, 0x80710008, 0x80310008, 0x80c30009,
-	0x000a0007, 0x80610008, 0x80210008, 0x80a30009,
-	0x80010008, 0x80810008, 0x80410008, 0x80e30009,
-	0x00060007, 0x80590008, 0x80190008, 0x80930009,
-	0x003b0307, 0x80790008, 0x80390008, 0x80d30009,
-	0x00110107, 0x80690008, 0x80290008, 0x80b30009,
-	0x80090008, 0x80890008, 0x80490008, 0x80f30009,
-	0x00040007, 0x80550008, 0x80150008, 0x01020008,
-	0x002b0307, 0x80750008, 0x80350008, 0x80cb0009,
-	0x000d0107, 0x80650008, 0x80250008, 0x80ab0009,
-	0x80050008, 0x80850008, 0x80450008, 0x80eb0009,
-	0x00080007, 0x805d0008, 0x801d0008, 0x809b0009,
-	0x00530407, 0x807d0008, 0x803d0008, 0x80db0009,
-	0x00170207, 0x806d0008, 0x802d0008, 0x80bb0009,
-	0x800d0008, 0x808d0008, 0x804d0008, 0x80fb0009,
-	0x00030007, 0x80530008, 0x80130008, 0x00c30508,
-	0x00230307, 0x80730008, 0x80330008, 0x80c70009,
-	0x000b0107, 0x80630008, 0x80230008, 0x80a70009,
-	0x80030008, 0x80830008, 0x80430008, 0x80e70009,
-	0x00070007, 0x805b0008, 0x801b0008, 0x80970009,
-	0x00430407, 0x807b0008, 0x803b0008, 0x80d70009,
-	0x00130207, 0x806b0008, 0x802b0008, 0x80b70009,
-	0x800b0008, 0x808b0008, 0x804b0008, 0x80f70009,
-	0x00050007, 0x80570008, 0x80170008, 0x00000008,
-	0x00330307, 0x80770008, 0x80370008, 0x80cf0009,
-	0x000f0107, 0x80670008, 0x80270008, 0x80af0009,
-	0x80070008, 0x80870008, 0x80470008, 0x80ef0009,
-	0x00090007, 0x805f0008, 0x801f0008, 0x809f0009,
-	0x00630407, 0x807f0008, 0x803f0008, 0x80df0009,
-	0x001b0207, 0x806f0008, 0x802f0008, 0x80bf0009,
-	0x800f0008, 0x808f0008, 0x804f0008, 0x80ff0009,
-	0x00004007, 0x80500008, 0x80100008, 0x00730408,
-	0x001f0207, 0x80700008, 0x80300008, 0x80c00009,
-	0x000a0007, 0x80600008, 0x80200008, 0x80a00009,
-	0x80000008, 0x80800008, 0x80400008, 0x80e00009,
-	0x00060007, 0x80580008, 0x80180008, 0x80900009,
-	0x003b0307, 0x80780008, 0x80380008, 0x80d00009,
-	0x00110107, 0x80680008, 0x80280008, 0x80b00009,
-	0x80080008, 0x80880008, 0x80480008, 0x80f00009,
-	0x00040007, 0x80540008, 0x80140008, 0x00e30508,
-	0x002b0307, 0x80740008, 0x80340008, 0x80c80009,
-	0x000d0107, 0x80640008, 0x80240008, 0x80a80009,
-	0x80040008, 0x80840008, 0x80440008, 0x80e80009,
-	0x00080007, 0x805c0008, 0x801c0008, 0x80980009,
-	0x00530407, 0x807c0008, 0x803c0008, 0x80d80009,
-	0x00170207, 0x806c0008, 0x802c0008, 0x80b80009,
-	0x800c0008, 0x808c0008, 0x804c0008, 0x80f80009,
-	0x00030007, 0x80520008, 0x80120008, 0x00a30508,
-	0x00230307, 0x80720008, 0x80320008, 0x80c40009,
-	0x000b0107, 0x80620008, 0x80220008, 0x80a40009,
-	0x80020008, 0x80820008, 0x80420008, 0x80e40009,
-	0x00070007, 0x805a0008, 0x801a0008, 0x80940009,
-	0x00430407, 0x807a0008, 0x803a0008, 0x80d40009,
-	0x00130207, 0x806a0008, 0x802a0008, 0x80b40009,
-	0x800a0008, 0x808a0008, 0x804a0008, 0x80f40009,
-	0x00050007, 0x80560008, 0x80160008, 0x00000008,
-	0x00330307, 0x80760008, 0x80360008, 0x80cc0009,
-	0x000f0107, 0x80660008, 0x80260008, 0x80ac0009,
-	0x80060008, 0x80860008, 0x80460008, 0x80ec0009,
-	0x00090007, 0x805e0008, 0x801e0008, 0x809c0009,
-	0x00630407, 0x807e0008, 0x803e0008, 0x80dc0009,
-	0x001b0207, 0x806e0008, 0x802e0008, 0x80bc0009,
-	0x800e0008, 0x808e0008, 0x804e0008, 0x80fc0009,
-	0x00004007, 0x80510008, 0x80110008, 0x00830508,
-	0x001f0207, 0x80710008, 0x80310008, 0x80c20009,
-	0x000a0007, 0x80610008, 0x80210008, 0x80a20009,
-	0x80010008, 0x80810008, 0x80410008, 0x80e20009,
-	0x00060007, 0x80590008, 0x80190008, 0x80920009,
-	0x003b0307, 0x80790008, 0x80390008, 0x80d20009,
-	0x00110107, 0x80690008, 0x80290008, 0x80b20009,
-	0x80090008, 0x80890008, 0x80490008, 0x80f20009,
-	0x00040007, 0x80550008, 0x80150008, 0x01020008,
-	0x002b0307, 0x80750008, 0x80350008, 0x80ca0009,
-	0x000d0107, 0x80650008, 0x80250008, 0x80aa0009,
-	0x80050008, 0x80850008, 0x80450008, 0x80ea0009,
-	0x00080007, 0x805d0008, 0x801d0008, 0x809a0009,
-	0x00530407, 0x807d0008, 0x803d0008, 0x80da0009,
-	0x00170207, 0x806d0008, 0x802d0008, 0x80ba0009,
-	0x800d0008, 0x808d0008, 0x804d0008, 0x80fa0009,
-	0x00030007, 0x80530008, 0x80130008, 0x00c30508,
-	0x00230307, 0x80730008, 0x80330008, 0x80c60009,
-	0x000b0107, 0x80630008, 0x80230008, 0x80a60009,
-	0x80030008, 0x80830008, 0x80430008, 0x80e60009,
-	0x00070007, 0x805b0008, 0x801b0008, 0x80960009,
-	0x00430407, 0x807b0008, 0x803b0008, 0x80d60009,
-	0x00130207, 0x806b0008, 0x802b0008, 0x80b60009,
-	0x800b0008, 0x808b0008, 0x804b0008, 0x80f60009,
-	0x00050007, 0x80570008, 0x80170008, 0x00000008,
-	0x00330307, 0x80770008, 0x80370008, 0x80ce0009,
-	0x000f0107, 0x80670008, 0x80270008, 0x80ae0009,
-	0x80070008, 0x80870008, 0x80470008, 0x80ee0009,
-	0x00090007, 0x805f0008, 0x801f0008, 0x809e0009,
-	0x00630407, 0x807f0008, 0x803f0008, 0x80de0009,
-	0x001b0207, 0x806f0008, 0x802f0008, 0x80be0009,
-	0x800f0008, 0x808f0008, 0x804f0008, 0x80fe0009,
-	0x00004007, 0x80500008, 0x80100008, 0x00730408,
-	0x001f0207, 0x80700008, 0x80300008, 0x80c10009,
-	0x000a0007, 0x80600008, 0x80200008, 0x80a10009,
-	0x80000008, 0x80800008, 0x80400008, 0x80e10009,
-	0x00060007, 0x80580008, 0x80180008, 0x80910009,
-	0x003b0307, 0x80780008, 0x80380008, 0x80d10009,
-	0x00110107, 0x80680008, 0x80280008, 0x80b10009,
-	0x80080008, 0x80880008, 0x80480008, 0x80f10009,
-	0x00040007, 0x80540008, 0x80140008, 0x00e30508,
-	0x002b0307, 0x80740008, 0x80340008, 0x80c90009,
-	0x000d0107, 0x80640008, 0x80240008, 0x80a90009,
-	0x80040008, 0x80840008, 0x80440008, 0x80e90009,
-	0x00080007, 0x805c0008, 0x801c0008, 0x80990009,
-	0x00530407, 0x807c0008, 0x803c0008, 0x80d90009,
-	0x00170207, 0x806c0008, 0x802c0008, 0x80b90009,
-	0x800c0008, 0x808c0008, 0x804c0008, 0x80f90009,
-	0x00030007, 0x80520008, 0x80120008, 0x00a30508,
-	0x00230307, 0x80720008, 0x80320008, 0x80c50009,
-	0x000b0107, 0x80620008, 0x80220008, 0x80a50009,
-	0x80020008, 0x80820008, 0x80420008, 0x80e50009,
-	0x00070007, 0x805a0008, 0x801a0008, 0x80950009,
-	0x00430407, 0x807a0008, 0x803a0008, 0x80d50009,
-	0x00130207, 0x806a0008, 0x802a0008, 0x80b50009,
-	0x800a0008, 0x808a0008, 0x804a0008, 0x80f50009,
-	0x00050007, 0x80560008, 0x80160008, 0x00000008,
-	0x00330307, 0x80760008, 0x80360008, 0x80cd0009,
-	0x000f0107, 0x80660008, 0x80260008, 0x80ad0009,
-	0x80060008, 0x80860008, 0x80460008, 0x80ed0009,
-	0x00090007, 0x805e0008, 0x801e0008, 0x809d0009,
-	0x00630407, 0x807e0008, 0x803e0008, 0x80dd0009,
-	0x001b0207, 0x806e0008, 0x802e0008, 0x80bd0009,
-	0x800e0008, 0x808e0008, 0x804e0008, 0x80fd0009,
-	0x00004007, 0x80510008, 0x80110008, 0x00830508,
-	0x001f0207, 0x80710008, 0x80310008, 0x80c30009,
-	0x000a0007, 0x80610008, 0x80210008, 0x80a30009,
-	0x80010008, 0x80810008, 0x80410008, 0x80e30009,
-	0x00060007, 0x80590008, 0x80190008, 0x80930009,
-	0x003b0307, 0x80790008, 0x80390008, 0x80d30009,
-	0x00110107, 0x80690008, 0x80290008, 0x80b30009,
-	0x80090008, 0x80890008, 0x80490008, 0x80f30009,
-	0x00040007, 0x80550008, 0x80150008, 0x01020008,
-	0x002b0307, 0x80750008, 0x80350008, 0x80cb0009,
-	0x000d0107, 0x80650008, 0x80250008, 0x80ab0009,
-	0x80050008, 0x80850008, 0x80450008, 0x80eb0009,
-	0x00080007, 0x805d0008, 0x801d0008, 0x809b0009,
-	0x00530407, 0x807d0008, 0x803d0008, 0x80db0009,
-	0x00170207, 0x806d0008, 0x802d0008, 0x80bb0009,
-	0x800d0008, 0x808d0008, 0x804d0008, 0x80fb0009,
-	0x00030007, 0x80530008, 0x80130008, 0x00c30508,
-	0x00230307, 0x80730008, 0x80330008, 0x80c70009,
-	0x000b0107, 0x80630008, 0x80230008, 0x80a70009,
-	0x80030008, 0x80830008, 0x80430008, 0x80e70009,
-	0x00070007, 0x805b0008, 0x801b0008, 0x80970009,
-	0x00430407, 0x807b0008, 0x803b0008, 0x80d70009,
-	0x00130207, 0x806b0008, 0x802b0008, 0x80b70009,
-	0x800b0008, 0x808b0008, 0x804b0008, 0x80f70009,
-	0x00050007, 0x80570008, 0x80170008, 0x00000008,
-	0x00330307, 0x80770008, 0x80370008, 0x80cf0009,
-	0x000f0107, 0x80670008, 0x80270008, 0x80af0009,
-	0x80070008, 0x80870008, 0x80470008, 0x80ef0009,
-	0x00090007, 0x805f0008, 0x801f0008, 0x809f0009,
-	0x00630407, 0x807f0008, 0x803f0008, 0x80df0009,
-	0x001b0207, 0x806f0008, 0x802f0008, 0x80bf0009,
-	0x800f0008, 0x808f0008, 0x804f0008, 0x80ff0009
+	0x00004007, 0x00508808, 0x00108808, 0x00730408,
+	0x001f0009, 0x00708808, 0x00308808, 0x00c08909,
+	0x000a0007, 0x00608808, 0x00208808, 0x00a08909,
+	0x00008808, 0x00808808, 0x00408808, 0x00e08909,
+	0x00060007, 0x00588808, 0x00188808, 0x00908909,
+	0x003b000a, 0x00788808, 0x00388808, 0x00d08909,
+	0x00110008, 0x00688808, 0x00288808, 0x00b08909,
+	0x00088808, 0x00888808, 0x00488808, 0x00f08909,
+	0x00040007, 0x00548808, 0x00148808, 0x00e30508,
+	0x002b000a, 0x00748808, 0x00348808, 0x00c88909,
+	0x000d0008, 0x00648808, 0x00248808, 0x00a88909,
+	0x00048808, 0x00848808, 0x00448808, 0x00e88909,
+	0x00080007, 0x005c8808, 0x001c8808, 0x00988909,
+	0x00530407, 0x007c8808, 0x003c8808, 0x00d88909,
+	0x00170009, 0x006c8808, 0x002c8808, 0x00b88909,
+	0x000c8808, 0x008c8808, 0x004c8808, 0x00f88909,
+	0x00030007, 0x00528808, 0x00128808, 0x00a30508,
+	0x0023000a, 0x00728808, 0x00328808, 0x00c48909,
+	0x000b0008, 0x00628808, 0x00228808, 0x00a48909,
+	0x00028808, 0x00828808, 0x00428808, 0x00e48909,
+	0x00070007, 0x005a8808, 0x001a8808, 0x00948909,
+	0x00430407, 0x007a8808, 0x003a8808, 0x00d48909,
+	0x00130009, 0x006a8808, 0x002a8808, 0x00b48909,
+	0x000a8808, 0x008a8808, 0x004a8808, 0x00f48909,
+	0x00050007, 0x00568808, 0x00168808, 0x00000008,
+	0x0033000a, 0x00768808, 0x00368808, 0x00cc8909,
+	0x000f0008, 0x00668808, 0x00268808, 0x00ac8909,
+	0x00068808, 0x00868808, 0x00468808, 0x00ec8909,
+	0x00090007, 0x005e8808, 0x001e8808, 0x009c8909,
+	0x00630407, 0x007e8808, 0x003e8808, 0x00dc8909,
+	0x001b0009, 0x006e8808, 0x002e8808, 0x00bc8909,
+	0x000e8808, 0x008e8808, 0x004e8808, 0x00fc8909,
+	0x00004007, 0x00518808, 0x00118808, 0x00830508,
+	0x00200009, 0x00718808, 0x00318808, 0x00c28909,
+	0x000a0007, 0x00618808, 0x00218808, 0x00a28909,
+	0x00018808, 0x00818808, 0x00418808, 0x00e28909,
+	0x00060007, 0x00598808, 0x00198808, 0x00928909,
+	0x003c000a, 0x00798808, 0x00398808, 0x00d28909,
+	0x00120008, 0x00698808, 0x00298808, 0x00b28909,
+	0x00098808, 0x00898808, 0x00498808, 0x00f28909,
+	0x00040007, 0x00558808, 0x00158808, 0x01020008,
+	0x002c000a, 0x00758808, 0x00358808, 0x00ca8909,
+	0x000e0008, 0x00658808, 0x00258808, 0x00aa8909,
+	0x00058808, 0x00858808, 0x00458808, 0x00ea8909,
+	0x00080007, 0x005d8808, 0x001d8808, 0x009a8909,
+	0x00530407, 0x007d8808, 0x003d8808, 0x00da8909,
+	0x00180009, 0x006d8808, 0x002d8808, 0x00ba8909,
+	0x000d8808, 0x008d8808, 0x004d8808, 0x00fa8909,
+	0x00030007, 0x00538808, 0x00138808, 0x00c30508,
+	0x0024000a, 0x00738808, 0x00338808, 0x00c68909,
+	0x000c0008, 0x00638808, 0x00238808, 0x00a68909,
+	0x00038808, 0x00838808, 0x00438808, 0x00e68909,
+	0x00070007, 0x005b8808, 0x001b8808, 0x00968909,
+	0x00430407, 0x007b8808, 0x003b8808, 0x00d68909,
+	0x00140009, 0x006b8808, 0x002b8808, 0x00b68909,
+	0x000b8808, 0x008b8808, 0x004b8808, 0x00f68909,
+	0x00050007, 0x00578808, 0x00178808, 0x00000008,
+	0x0034000a, 0x00778808, 0x00378808, 0x00ce8909,
+	0x00100008, 0x00678808, 0x00278808, 0x00ae8909,
+	0x00078808, 0x00878808, 0x00478808, 0x00ee8909,
+	0x00090007, 0x005f8808, 0x001f8808, 0x009e8909,
+	0x00630407, 0x007f8808, 0x003f8808, 0x00de8909,
+	0x001c0009, 0x006f8808, 0x002f8808, 0x00be8909,
+	0x000f8808, 0x008f8808, 0x004f8808, 0x00fe8909,
+	0x00004007, 0x00508808, 0x00108808, 0x00730408,
+	0x00210009, 0x00708808, 0x00308808, 0x00c18909,
+	0x000a0007, 0x00608808, 0x00208808, 0x00a18909,
+	0x00008808, 0x00808808, 0x00408808, 0x00e18909,
+	0x00060007, 0x00588808, 0x00188808, 0x00918909,
+	0x003d000a, 0x00788808, 0x00388808, 0x00d18909,
+	0x00110008, 0x00688808, 0x00288808, 0x00b18909,
+	0x00088808, 0x00888808, 0x00488808, 0x00f18909,
+	0x00040007, 0x00548808, 0x00148808, 0x00e30508,
+	0x002d000a, 0x00748808, 0x00348808, 0x00c98909,
+	0x000d0008, 0x00648808, 0x00248808, 0x00a98909,
+	0x00048808, 0x00848808, 0x00448808, 0x00e98909,
+	0x00080007, 0x005c8808, 0x001c8808, 0x00998909,
+	0x00530407, 0x007c8808, 0x003c8808, 0x00d98909,
+	0x00190009, 0x006c8808, 0x002c8808, 0x00b98909,
+	0x000c8808, 0x008c8808, 0x004c8808, 0x00f98909,
+	0x00030007, 0x00528808, 0x00128808, 0x00a30508,
+	0x0025000a, 0x00728808, 0x00328808, 0x00c58909,
+	0x000b0008, 0x00628808, 0x00228808, 0x00a58909,
+	0x00028808, 0x00828808, 0x00428808, 0x00e58909,
+	0x00070007, 0x005a8808, 0x001a8808, 0x00958909,
+	0x00430407, 0x007a8808, 0x003a8808, 0x00d58909,
+	0x00150009, 0x006a8808, 0x002a8808, 0x00b58909,
+	0x000a8808, 0x008a8808, 0x004a8808, 0x00f58909,
+	0x00050007, 0x00568808, 0x00168808, 0x00000008,
+	0x0035000a, 0x00768808, 0x00368808, 0x00cd8909,
+	0x000f0008, 0x00668808, 0x00268808, 0x00ad8909,
+	0x00068808, 0x00868808, 0x00468808, 0x00ed8909,
+	0x00090007, 0x005e8808, 0x001e8808, 0x009d8909,
+	0x00630407, 0x007e8808, 0x003e8808, 0x00dd8909,
+	0x001d0009, 0x006e8808, 0x002e8808, 0x00bd8909,
+	0x000e8808, 0x008e8808, 0x004e8808, 0x00fd8909,
+	0x00004007, 0x00518808, 0x00118808, 0x00830508,
+	0x00220009, 0x00718808, 0x00318808, 0x00c38909,
+	0x000a0007, 0x00618808, 0x00218808, 0x00a38909,
+	0x00018808, 0x00818808, 0x00418808, 0x00e38909,
+	0x00060007, 0x00598808, 0x00198808, 0x00938909,
+	0x003e000a, 0x00798808, 0x00398808, 0x00d38909,
+	0x00120008, 0x00698808, 0x00298808, 0x00b38909,
+	0x00098808, 0x00898808, 0x00498808, 0x00f38909,
+	0x00040007, 0x00558808, 0x00158808, 0x01020008,
+	0x002e000a, 0x00758808, 0x00358808, 0x00cb8909,
+	0x000e0008, 0x00658808, 0x00258808, 0x00ab8909,
+	0x00058808, 0x00858808, 0x00458808, 0x00eb8909,
+	0x00080007, 0x005d8808, 0x001d8808, 0x009b8909,
+	0x00530407, 0x007d8808, 0x003d8808, 0x00db8909,
+	0x001a0009, 0x006d8808, 0x002d8808, 0x00bb8909,
+	0x000d8808, 0x008d8808, 0x004d8808, 0x00fb8909,
+	0x00030007, 0x00538808, 0x00138808, 0x00c30508,
+	0x0026000a, 0x00738808, 0x00338808, 0x00c78909,
+	0x000c0008, 0x00638808, 0x00238808, 0x00a78909,
+	0x00038808, 0x00838808, 0x00438808, 0x00e78909,
+	0x00070007, 0x005b8808, 0x001b8808, 0x00978909,
+	0x00430407, 0x007b8808, 0x003b8808, 0x00d78909,
+	0x00160009, 0x006b8808, 0x002b8808, 0x00b78909,
+	0x000b8808, 0x008b8808, 0x004b8808, 0x00f78909,
+	0x00050007, 0x00578808, 0x00178808, 0x00000008,
+	0x0036000a, 0x00778808, 0x00378808, 0x00cf8909,
+	0x00100008, 0x00678808, 0x00278808, 0x00af8909,
+	0x00078808, 0x00878808, 0x00478808, 0x00ef8909,
+	0x00090007, 0x005f8808, 0x001f8808, 0x009f8909,
+	0x00630407, 0x007f8808, 0x003f8808, 0x00df8909,
+	0x001e0009, 0x006f8808, 0x002f8808, 0x00bf8909,
+	0x000f8808, 0x008f8808, 0x004f8808, 0x00ff8909,
+	0x00004007, 0x00508808, 0x00108808, 0x00730408,
+	0x001f0009, 0x00708808, 0x00308808, 0x00c08909,
+	0x000a0007, 0x00608808, 0x00208808, 0x00a08909,
+	0x00008808, 0x00808808, 0x00408808, 0x00e08909,
+	0x00060007, 0x00588808, 0x00188808, 0x00908909,
+	0x003f000a, 0x00788808, 0x00388808, 0x00d08909,
+	0x00110008, 0x00688808, 0x00288808, 0x00b08909,
+	0x00088808, 0x00888808, 0x00488808, 0x00f08909,
+	0x00040007, 0x00548808, 0x00148808, 0x00e30508,
+	0x002f000a, 0x00748808, 0x00348808, 0x00c88909,
+	0x000d0008, 0x00648808, 0x00248808, 0x00a88909,
+	0x00048808, 0x00848808, 0x00448808, 0x00e88909,
+	0x00080007, 0x005c8808, 0x001c8808, 0x00988909,
+	0x00530407, 0x007c8808, 0x003c8808, 0x00d88909,
+	0x00170009, 0x006c8808, 0x002c8808, 0x00b88909,
+	0x000c8808, 0x008c8808, 0x004c8808, 0x00f88909,
+	0x00030007, 0x00528808, 0x00128808, 0x00a30508,
+	0x0027000a, 0x00728808, 0x00328808, 0x00c48909,
+	0x000b0008, 0x00628808, 0x00228808, 0x00a48909,
+	0x00028808, 0x00828808, 0x00428808, 0x00e48909,
+	0x00070007, 0x005a8808, 0x001a8808, 0x00948909,
+	0x00430407, 0x007a8808, 0x003a8808, 0x00d48909,
+	0x00130009, 0x006a8808, 0x002a8808, 0x00b48909,
+	0x000a8808, 0x008a8808, 0x004a8808, 0x00f48909,
+	0x00050007, 0x00568808, 0x00168808, 0x00000008,
+	0x0037000a, 0x00768808, 0x00368808, 0x00cc8909,
+	0x000f0008, 0x00668808, 0x00268808, 0x00ac8909,
+	0x00068808, 0x00868808, 0x00468808, 0x00ec8909,
+	0x00090007, 0x005e8808, 0x001e8808, 0x009c8909,
+	0x00630407, 0x007e8808, 0x003e8808, 0x00dc8909,
+	0x001b0009, 0x006e8808, 0x002e8808, 0x00bc8909,
+	0x000e8808, 0x008e8808, 0x004e8808, 0x00fc8909,
+	0x00004007, 0x00518808, 0x00118808, 0x00830508,
+	0x00200009, 0x00718808, 0x00318808, 0x00c28909,
+	0x000a0007, 0x00618808, 0x00218808, 0x00a28909,
+	0x00018808, 0x00818808, 0x00418808, 0x00e28909,
+	0x00060007, 0x00598808, 0x00198808, 0x00928909,
+	0x0040000a, 0x00798808, 0x00398808, 0x00d28909,
+	0x00120008, 0x00698808, 0x00298808, 0x00b28909,
+	0x00098808, 0x00898808, 0x00498808, 0x00f28909,
+	0x00040007, 0x00558808, 0x00158808, 0x01020008,
+	0x0030000a, 0x00758808, 0x00358808, 0x00ca8909,
+	0x000e0008, 0x00658808, 0x00258808, 0x00aa8909,
+	0x00058808, 0x00858808, 0x00458808, 0x00ea8909,
+	0x00080007, 0x005d8808, 0x001d8808, 0x009a8909,
+	0x00530407, 0x007d8808, 0x003d8808, 0x00da8909,
+	0x00180009, 0x006d8808, 0x002d8808, 0x00ba8909,
+	0x000d8808, 0x008d8808, 0x004d8808, 0x00fa8909,
+	0x00030007, 0x00538808, 0x00138808, 0x00c30508,
+	0x0028000a, 0x00738808, 0x00338808, 0x00c68909,
+	0x000c0008, 0x00638808, 0x00238808, 0x00a68909,
+	0x00038808, 0x00838808, 0x00438808, 0x00e68909,
+	0x00070007, 0x005b8808, 0x001b8808, 0x00968909,
+	0x00430407, 0x007b8808, 0x003b8808, 0x00d68909,
+	0x00140009, 0x006b8808, 0x002b8808, 0x00b68909,
+	0x000b8808, 0x008b8808, 0x004b8808, 0x00f68909,
+	0x00050007, 0x00578808, 0x00178808, 0x00000008,
+	0x0038000a, 0x00778808, 0x00378808, 0x00ce8909,
+	0x00100008, 0x00678808, 0x00278808, 0x00ae8909,
+	0x00078808, 0x00878808, 0x00478808, 0x00ee8909,
+	0x00090007, 0x005f8808, 0x001f8808, 0x009e8909,
+	0x00630407, 0x007f8808, 0x003f8808, 0x00de8909,
+	0x001c0009, 0x006f8808, 0x002f8808, 0x00be8909,
+	0x000f8808, 0x008f8808, 0x004f8808, 0x00fe8909,
+	0x00004007, 0x00508808, 0x00108808, 0x00730408,
+	0x00210009, 0x00708808, 0x00308808, 0x00c18909,
+	0x000a0007, 0x00608808, 0x00208808, 0x00a18909,
+	0x00008808, 0x00808808, 0x00408808, 0x00e18909,
+	0x00060007, 0x00588808, 0x00188808, 0x00918909,
+	0x0041000a, 0x00788808, 0x00388808, 0x00d18909,
+	0x00110008, 0x00688808, 0x00288808, 0x00b18909,
+	0x00088808, 0x00888808, 0x00488808, 0x00f18909,
+	0x00040007, 0x00548808, 0x00148808, 0x00e30508,
+	0x0031000a, 0x00748808, 0x00348808, 0x00c98909,
+	0x000d0008, 0x00648808, 0x00248808, 0x00a98909,
+	0x00048808, 0x00848808, 0x00448808, 0x00e98909,
+	0x00080007, 0x005c8808, 0x001c8808, 0x00998909,
+	0x00530407, 0x007c8808, 0x003c8808, 0x00d98909,
+	0x00190009, 0x006c8808, 0x002c8808, 0x00b98909,
+	0x000c8808, 0x008c8808, 0x004c8808, 0x00f98909,
+	0x00030007, 0x00528808, 0x00128808, 0x00a30508,
+	0x0029000a, 0x00728808, 0x00328808, 0x00c58909,
+	0x000b0008, 0x00628808, 0x00228808, 0x00a58909,
+	0x00028808, 0x00828808, 0x00428808, 0x00e58909,
+	0x00070007, 0x005a8808, 0x001a8808, 0x00958909,
+	0x00430407, 0x007a8808, 0x003a8808, 0x00d58909,
+	0x00150009, 0x006a8808, 0x002a8808, 0x00b58909,
+	0x000a8808, 0x008a8808, 0x004a8808, 0x00f58909,
+	0x00050007, 0x00568808, 0x00168808, 0x00000008,
+	0x0039000a, 0x00768808, 0x00368808, 0x00cd8909,
+	0x000f0008, 0x00668808, 0x00268808, 0x00ad8909,
+	0x00068808, 0x00868808, 0x00468808, 0x00ed8909,
+	0x00090007, 0x005e8808, 0x001e8808, 0x009d8909,
+	0x00630407, 0x007e8808, 0x003e8808, 0x00dd8909,
+	0x001d0009, 0x006e8808, 0x002e8808, 0x00bd8909,
+	0x000e8808, 0x008e8808, 0x004e8808, 0x00fd8909,
+	0x00004007, 0x00518808, 0x00118808, 0x00830508,
+	0x00220009, 0x00718808, 0x00318808, 0x00c38909,
+	0x000a0007, 0x00618808, 0x00218808, 0x00a38909,
+	0x00018808, 0x00818808, 0x00418808, 0x00e38909,
+	0x00060007, 0x00598808, 0x00198808, 0x00938909,
+	0x0042000a, 0x00798808, 0x00398808, 0x00d38909,
+	0x00120008, 0x00698808, 0x00298808, 0x00b38909,
+	0x00098808, 0x00898808, 0x00498808, 0x00f38909,
+	0x00040007, 0x00558808, 0x00158808, 0x01020008,
+	0x0032000a, 0x00758808, 0x00358808, 0x00cb8909,
+	0x000e0008, 0x00658808, 0x00258808, 0x00ab8909,
+	0x00058808, 0x00858808, 0x00458808, 0x00eb8909,
+	0x00080007, 0x005d8808, 0x001d8808, 0x009b8909,
+	0x00530407, 0x007d8808, 0x003d8808, 0x00db8909,
+	0x001a0009, 0x006d8808, 0x002d8808, 0x00bb8909,
+	0x000d8808, 0x008d8808, 0x004d8808, 0x00fb8909,
+	0x00030007, 0x00538808, 0x00138808, 0x00c30508,
+	0x002a000a, 0x00738808, 0x00338808, 0x00c78909,
+	0x000c0008, 0x00638808, 0x00238808, 0x00a78909,
+	0x00038808, 0x00838808, 0x00438808, 0x00e78909,
+	0x00070007, 0x005b8808, 0x001b8808, 0x00978909,
+	0x00430407, 0x007b8808, 0x003b8808, 0x00d78909,
+	0x00160009, 0x006b8808, 0x002b8808, 0x00b78909,
+	0x000b8808, 0x008b8808, 0x004b8808, 0x00f78909,
+	0x00050007, 0x00578808, 0x00178808, 0x00000008,
+	0x003a000a, 0x00778808, 0x00378808, 0x00cf8909,
+	0x00100008, 0x00678808, 0x00278808, 0x00af8909,
+	0x00078808, 0x00878808, 0x00478808, 0x00ef8909,
+	0x00090007, 0x005f8808, 0x001f8808, 0x009f8909,
+	0x00630407, 0x007f8808, 0x003f8808, 0x00df8909,
+	0x001e0009, 0x006f8808, 0x002f8808, 0x00bf8909,
+	0x000f8808, 0x008f8808, 0x004f8808, 0x00ff8909
 };
 
 static const uint32 dsttctable_[] = {
-	0x00010005, 0x01010705, 0x00110305, 0x10010b05,
-	0x00050105, 0x04010905, 0x00410505, 0x40010d05,
+	0x00010005, 0x01010705, 0x00110008, 0x10010b05,
+	0x00050006, 0x04010905, 0x00410505, 0x40010d05,
 	0x00030005, 0x02010805, 0x00210405, 0x20010c05,
-	0x00090205, 0x08010a05, 0x00810605, 0x00000005,
-	0x00020005, 0x01810705, 0x00190305, 0x18010b05,
-	0x00070105, 0x06010905, 0x00610505, 0x60010d05,
+	0x00090007, 0x08010a05, 0x00810605, 0x00000005,
+	0x00020005, 0x01810705, 0x00190008, 0x18010b05,
+	0x00070006, 0x06010905, 0x00610505, 0x60010d05,
 	0x00040005, 0x03010805, 0x00310405, 0x30010c05,
-	0x000d0205, 0x0c010a05, 0x00c10605, 0x00000005,
-	0x00010005, 0x01010705, 0x00110305, 0x10010b05,
-	0x00050105, 0x04010905, 0x00410505, 0x40010d05,
+	0x000d0007, 0x0c010a05, 0x00c10605, 0x00000005,
+	0x00010005, 0x01010705, 0x00120008, 0x10010b05,
+	0x00060006, 0x04010905, 0x00410505, 0x40010d05,
 	0x00030005, 0x02010805, 0x00210405, 0x20010c05,
-	0x00090205, 0x08010a05, 0x00810605, 0x00000005,
-	0x00020005, 0x01810705, 0x00190305, 0x18010b05,
-	0x00070105, 0x06010905, 0x00610505, 0x60010d05,
+	0x000a0007, 0x08010a05, 0x00810605, 0x00000005,
+	0x00020005, 0x01810705, 0x001a0008, 0x18010b05,
+	0x00080006, 0x06010905, 0x00610505, 0x60010d05,
 	0x00040005, 0x03010805, 0x00310405, 0x30010c05,
-	0x000d0205, 0x0c010a05, 0x00c10605, 0x00000005,
-	0x00010005, 0x01010705, 0x00110305, 0x10010b05,
-	0x00050105, 0x04010905, 0x00410505, 0x40010d05,
+	0x000e0007, 0x0c010a05, 0x00c10605, 0x00000005,
+	0x00010005, 0x01010705, 0x00130008, 0x10010b05,
+	0x00050006, 0x04010905, 0x00410505, 0x40010d05,
 	0x00030005, 0x02010805, 0x00210405, 0x20010c05,
-	0x00090205, 0x08010a05, 0x00810605, 0x00000005,
-	0x00020005, 0x01810705, 0x00190305, 0x18010b05,
-	0x00070105, 0x06010905, 0x00610505, 0x60010d05,
+	0x000b0007, 0x08010a05, 0x00810605, 0x00000005,
+	0x00020005, 0x01810705, 0x001b0008, 0x18010b05,
+	0x00070006, 0x06010905, 0x00610505, 0x60010d05,
 	0x00040005, 0x03010805, 0x00310405, 0x30010c05,
-	0x000d0205, 0x0c010a05, 0x00c10605, 0x00000005,
-	0x00010005, 0x01010705, 0x00110305, 0x10010b05,
-	0x00050105, 0x04010905, 0x00410505, 0x40010d05,
+	0x000f0007, 0x0c010a05, 0x00c10605, 0x00000005,
+	0x00010005, 0x01010705, 0x00140008, 0x10010b05,
+	0x00060006, 0x04010905, 0x00410505, 0x40010d05,
 	0x00030005, 0x02010805, 0x00210405, 0x20010c05,
-	0x00090205, 0x08010a05, 0x00810605, 0x00000005,
-	0x00020005, 0x01810705, 0x00190305, 0x18010b05,
-	0x00070105, 0x06010905, 0x00610505, 0x60010d05,
+	0x000c0007, 0x08010a05, 0x00810605, 0x00000005,
+	0x00020005, 0x01810705, 0x001c0008, 0x18010b05,
+	0x00080006, 0x06010905, 0x00610505, 0x60010d05,
 	0x00040005, 0x03010805, 0x00310405, 0x30010c05,
-	0x000d0205, 0x0c010a05, 0x00c10605, 0x00000005,
-	0x00010005, 0x01010705, 0x00110305, 0x10010b05,
-	0x00050105, 0x04010905, 0x00410505, 0x40010d05,
+	0x00100007, 0x0c010a05, 0x00c10605, 0x00000005,
+	0x00010005, 0x01010705, 0x00150008, 0x10010b05,
+	0x00050006, 0x04010905, 0x00410505, 0x40010d05,
 	0x00030005, 0x02010805, 0x00210405, 0x20010c05,
-	0x00090205, 0x08010a05, 0x00810605, 0x00000005,
-	0x00020005, 0x01810705, 0x00190305, 0x18010b05,
-	0x00070105, 0x06010905, 0x00610505, 0x60010d05,
+	0x00090007, 0x08010a05, 0x00810605, 0x00000005,
+	0x00020005, 0x01810705, 0x001d0008, 0x18010b05,
+	0x00070006, 0x06010905, 0x00610505, 0x60010d05,
 	0x00040005, 0x03010805, 0x00310405, 0x30010c05,
-	0x000d0205, 0x0c010a05, 0x00c10605, 0x00000005,
-	0x00010005, 0x01010705, 0x00110305, 0x10010b05,
-	0x00050105, 0x04010905, 0x00410505, 0x40010d05,
+	0x000d0007, 0x0c010a05, 0x00c10605, 0x00000005,
+	0x00010005, 0x01010705, 0x00160008, 0x10010b05,
+	0x00060006, 0x04010905, 0x00410505, 0x40010d05,
 	0x00030005, 0x02010805, 0x00210405, 0x20010c05,
-	0x00090205, 0x08010a05, 0x00810605, 0x00000005,
-	0x00020005, 0x01810705, 0x00190305, 0x18010b05,
-	0x00070105, 0x06010905, 0x00610505, 0x60010d05,
+	0x000a0007, 0x08010a05, 0x00810605, 0x00000005,
+	0x00020005, 0x01810705, 0x001e0008, 0x18010b05,
+	0x00080006, 0x06010905, 0x00610505, 0x60010d05,
 	0x00040005, 0x03010805, 0x00310405, 0x30010c05,
-	0x000d0205, 0x0c010a05, 0x00c10605, 0x00000005,
-	0x00010005, 0x01010705, 0x00110305, 0x10010b05,
-	0x00050105, 0x04010905, 0x00410505, 0x40010d05,
+	0x000e0007, 0x0c010a05, 0x00c10605, 0x00000005,
+	0x00010005, 0x01010705, 0x00170008, 0x10010b05,
+	0x00050006, 0x04010905, 0x00410505, 0x40010d05,
 	0x00030005, 0x02010805, 0x00210405, 0x20010c05,
-	0x00090205, 0x08010a05, 0x00810605, 0x00000005,
-	0x00020005, 0x01810705, 0x00190305, 0x18010b05,
-	0x00070105, 0x06010905, 0x00610505, 0x60010d05,
+	0x000b0007, 0x08010a05, 0x00810605, 0x00000005,
+	0x00020005, 0x01810705, 0x001f0008, 0x18010b05,
+	0x00070006, 0x06010905, 0x00610505, 0x60010d05,
 	0x00040005, 0x03010805, 0x00310405, 0x30010c05,
-	0x000d0205, 0x0c010a05, 0x00c10605, 0x00000005,
-	0x00010005, 0x01010705, 0x00110305, 0x10010b05,
-	0x00050105, 0x04010905, 0x00410505, 0x40010d05,
+	0x000f0007, 0x0c010a05, 0x00c10605, 0x00000005,
+	0x00010005, 0x01010705, 0x00180008, 0x10010b05,
+	0x00060006, 0x04010905, 0x00410505, 0x40010d05,
 	0x00030005, 0x02010805, 0x00210405, 0x20010c05,
-	0x00090205, 0x08010a05, 0x00810605, 0x00000005,
-	0x00020005, 0x01810705, 0x00190305, 0x18010b05,
-	0x00070105, 0x06010905, 0x00610505, 0x60010d05,
+	0x000c0007, 0x08010a05, 0x00810605, 0x00000005,
+	0x00020005, 0x01810705, 0x00200008, 0x18010b05,
+	0x00080006, 0x06010905, 0x00610505, 0x60010d05,
 	0x00040005, 0x03010805, 0x00310405, 0x30010c05,
-	0x000d0205, 0x0c010a05, 0x00c10605, 0x00000005
+	0x00100007, 0x0c010a05, 0x00c10605, 0x00000005
 };
 
 static const uint32* dsttctable = dsttctable_;
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2025, jpn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef a180ebc1_72da_48ed_a695_fcf7244b22d4
+#define a180ebc1_72da_48ed_a695_fcf7244b22d4
+
+/*
+ * threads.h
+ * Minimal thread primitives (internal use only).
+ *
+ * This is only available when the library is built with JDEFLATE_THREADS
+ * defined, the callers must provide a fallback path for when it's not. */
+
+#include <ctoolbox/ctoolbox.h>
+
+
+#if defined(JDEFLATE_THREADS)
+
+#if defined(_WIN32)
+	#include <windows.h>
+
+	typedef HANDLE TThread;
+	typedef CRITICAL_SECTION   TMutex;
+	typedef CONDITION_VARIABLE TCondition;
+
+	#define THREADPROC(NAME) static DWORD WINAPI NAME(LPVOID argument)
+	#define THREADRETURN return 0
+
+	typedef DWORD (WINAPI *TThreadFn)(LPVOID);
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+
+	typedef pthread_t TThread;
+	typedef pthread_mutex_t TMutex;
+	typedef pthread_cond_t  TCondition;
+
+	#define THREADPROC(NAME) static void* NAME(void* argument)
+	#define THREADRETURN return NULL
+
+	typedef void* (*TThreadFn)(void*);
+#endif
+
+
+#if defined(_WIN32)
+
+CTB_INLINE bool
+thread_create(TThread* thread, TThreadFn fn, void* argument)
+{
+	thread[0] = CreateThread(NULL, 0, fn, argument, 0, NULL);
+	return thread[0] != NULL;
+}
+
+CTB_INLINE void
+thread_join(TThread* thread)
+{
+	WaitForSingleObject(thread[0], INFINITE);
+	CloseHandle(thread[0]);
+}
+
+CTB_INLINE bool
+mutex_init(TMutex* mutex)
+{
+	InitializeCriticalSection(mutex);
+	return 1;
+}
+
+CTB_INLINE void
+mutex_destroy(TMutex* mutex)
+{
+	DeleteCriticalSection(mutex);
+}
+
+CTB_INLINE void
+mutex_lock(TMutex* mutex)
+{
+	EnterCriticalSection(mutex);
+}
+
+CTB_INLINE void
+mutex_unlock(TMutex* mutex)
+{
+	LeaveCriticalSection(mutex);
+}
+
+CTB_INLINE bool
+cond_init(TCondition* cond)
+{
+	InitializeConditionVariable(cond);
+	return 1;
+}
+
+CTB_INLINE void
+cond_destroy(TCondition* cond)
+{
+	(void) cond;
+}
+
+CTB_INLINE void
+cond_wait(TCondition* cond, TMutex* mutex)
+{
+	SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+CTB_INLINE void
+cond_signal(TCondition* cond)
+{
+	WakeConditionVariable(cond);
+}
+
+CTB_INLINE void
+cond_broadcast(TCondition* cond)
+{
+	WakeAllConditionVariable(cond);
+}
+
+CTB_INLINE uintxx
+thread_cpucount(void)
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (uintxx) info.dwNumberOfProcessors;
+}
+
+#else
+
+CTB_INLINE bool
+thread_create(TThread* thread, TThreadFn fn, void* argument)
+{
+	return pthread_create(thread, NULL, fn, argument) == 0;
+}
+
+CTB_INLINE void
+thread_join(TThread* thread)
+{
+	pthread_join(thread[0], NULL);
+}
+
+CTB_INLINE bool
+mutex_init(TMutex* mutex)
+{
+	return pthread_mutex_init(mutex, NULL) == 0;
+}
+
+CTB_INLINE void
+mutex_destroy(TMutex* mutex)
+{
+	pthread_mutex_destroy(mutex);
+}
+
+CTB_INLINE void
+mutex_lock(TMutex* mutex)
+{
+	pthread_mutex_lock(mutex);
+}
+
+CTB_INLINE void
+mutex_unlock(TMutex* mutex)
+{
+	pthread_mutex_unlock(mutex);
+}
+
+CTB_INLINE bool
+cond_init(TCondition* cond)
+{
+	return pthread_cond_init(cond, NULL) == 0;
+}
+
+CTB_INLINE void
+cond_destroy(TCondition* cond)
+{
+	pthread_cond_destroy(cond);
+}
+
+CTB_INLINE void
+cond_wait(TCondition* cond, TMutex* mutex)
+{
+	pthread_cond_wait(cond, mutex);
+}
+
+CTB_INLINE void
+cond_signal(TCondition* cond)
+{
+	pthread_cond_signal(cond);
+}
+
+CTB_INLINE void
+cond_broadcast(TCondition* cond)
+{
+	pthread_cond_broadcast(cond);
+}
+
+CTB_INLINE uintxx
+thread_cpucount(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+	long n;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > 0) {
+		return (uintxx) n;
+	}
+#endif
+	return 1;
+}
+
+#endif
+
+#endif
+
+#endif
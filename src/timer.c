@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2025, jpn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_WIN32)
+	#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "timer.h"
+
+
+#if defined(_WIN32)
+	#include <windows.h>
+
+	#define TIMER_WINDOWS
+#else
+	#include <time.h>
+	#include <unistd.h>
+
+	#if defined(_POSIX_TIMERS) && defined(CLOCK_MONOTONIC)
+		#define TIMER_POSIX
+	#endif
+#endif
+
+
+#if defined(TIMER_WINDOWS)
+
+uint64
+timer_now(void)
+{
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+	uint64 n;
+	uint64 f;
+
+	if (QueryPerformanceFrequency(&frequency) == 0) {
+		return 0;
+	}
+	QueryPerformanceCounter(&counter);
+
+	/* split to avoid the overflow of counter * 10^9 */
+	n = (uint64) counter.QuadPart;
+	f = (uint64) frequency.QuadPart;
+	return (n / f) * 1000000000ull + ((n % f) * 1000000000ull) / f;
+}
+
+#else
+#if defined(TIMER_POSIX)
+
+uint64
+timer_now(void)
+{
+	struct timespec t;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &t) != 0) {
+		return 0;
+	}
+	return ((uint64) t.tv_sec) * 1000000000ull + (uint64) t.tv_nsec;
+}
+
+#else
+
+uint64
+timer_now(void)
+{
+	return 0;
+}
+
+#endif
+#endif
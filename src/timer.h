@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2025, jpn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef e6b1d0a7_93c4_4f2e_8a51_7f0c2d9b4e86
+#define e6b1d0a7_93c4_4f2e_8a51_7f0c2d9b4e86
+
+/*
+ * timer.h
+ * Monotonic clock (internal use only).
+ *
+ * Not every system has one, the callers must provide a fallback path for
+ * when timer_now returns zero. */
+
+#include <ctoolbox/ctoolbox.h>
+
+
+/* Returns the time in nanoseconds from an arbitrary point or zero if there
+ * is no monotonic clock. */
+uint64 timer_now(void);
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2025, jpn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if defined(__linux__)
+	#define _GNU_SOURCE
+#else
+	#if !defined(_WIN32)
+		#define _DEFAULT_SOURCE
+		#define _DARWIN_C_SOURCE
+	#endif
+#endif
+
+#include "vmirror.h"
+
+
+#if defined(_WIN32)
+	#include <windows.h>
+
+	#define VMIRROR_WINDOWS
+#else
+	#if defined(__unix__) || defined(__APPLE__)
+		#include <sys/mman.h>
+		#include <fcntl.h>
+		#include <unistd.h>
+
+		#if defined(MAP_FIXED) && defined(MAP_SHARED)
+			#define VMIRROR_POSIX
+		#endif
+	#endif
+#endif
+
+
+#if defined(VMIRROR_WINDOWS)
+
+void*
+vmirror_create(uintxx size)
+{
+	HANDLE mapping;
+	SYSTEM_INFO info;
+	uintxx i;
+	uint8* r;
+
+	GetSystemInfo(&info);
+	if (size == 0 || size % info.dwAllocationGranularity) {
+		return NULL;
+	}
+
+	mapping = CreateFileMapping(
+		INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD) size, NULL);
+	if (mapping == NULL) {
+		return NULL;
+	}
+
+	/* there is no way to map a view at a reserved range without the newer
+	 * placeholder api, another thread can take the range between the
+	 * release and the mapping so we retry a few times */
+	r = NULL;
+	for (i = 0; i < 8; i++) {
+		uint8* b;
+		uint8* p1;
+		uint8* p2;
+
+		b = VirtualAlloc(NULL, size << 1, MEM_RESERVE, PAGE_NOACCESS);
+		if (b == NULL) {
+			break;
+		}
+		VirtualFree(b, 0, MEM_RELEASE);
+
+		p1 = MapViewOfFileEx(mapping, FILE_MAP_WRITE, 0, 0, size, b);
+		if (p1 == NULL) {
+			continue;
+		}
+		p2 = MapViewOfFileEx(mapping, FILE_MAP_WRITE, 0, 0, size, b + size);
+		if (p2 == NULL) {
+			UnmapViewOfFile(p1);
+			continue;
+		}
+		r = p1;
+		break;
+	}
+
+	/* the views keep the section alive */
+	CloseHandle(mapping);
+	return r;
+}
+
+void
+vmirror_destroy(void* buffer, uintxx size)
+{
+	if (buffer == NULL) {
+		return;
+	}
+	UnmapViewOfFile(((uint8*) buffer) + size);
+	UnmapViewOfFile(buffer);
+}
+
+#else
+#if defined(VMIRROR_POSIX)
+
+static int
+createfile(uintxx size)
+{
+	int fd;
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+	fd = memfd_create("jdeflate", MFD_CLOEXEC);
+#else
+	char name[32];
+	uintxx i;
+	uintxx n;
+
+	/* anonymous shared memory object, the name is removed as soon as it's
+	 * created */
+	n = (uintxx) getpid();
+	fd = -1;
+	for (i = 0; i < 8 && fd == -1; i++) {
+		uintxx j;
+		uintxx k;
+
+		name[0] = '/';
+		name[1] = 'j';
+		name[2] = 'd';
+		name[3] = 'm';
+		k = n + (((uintxx) &name[i]) >> 4) + i;
+		for (j = 4; j < 4 + 16; j++) {
+			name[j] = (char) ('a' + (k & 0x0f));
+			k >>= 4;
+		}
+		name[j] = 0;
+
+		fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd != -1) {
+			shm_unlink(name);
+		}
+	}
+#endif
+	if (fd == -1) {
+		return -1;
+	}
+
+	if (ftruncate(fd, (off_t) size) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void*
+vmirror_create(uintxx size)
+{
+	int fd;
+	long pagesize;
+	uint8* b;
+	void* p;
+
+	pagesize = sysconf(_SC_PAGESIZE);
+	if (size == 0 || pagesize <= 0 || size % (uintxx) pagesize) {
+		return NULL;
+	}
+
+	fd = createfile(size);
+	if (fd == -1) {
+		return NULL;
+	}
+
+	/* reserve the whole range and map the file twice over it */
+	p = mmap(NULL, size << 1, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (p == MAP_FAILED) {
+		goto L_ERROR1;
+	}
+	b = p;
+
+	p = mmap(b, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+	if (p == MAP_FAILED) {
+		goto L_ERROR2;
+	}
+	p = mmap(
+		b + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+	if (p == MAP_FAILED) {
+		goto L_ERROR2;
+	}
+
+	/* the mappings keep the file alive */
+	close(fd);
+	return b;
+
+L_ERROR2:
+	munmap(b, size << 1);
+L_ERROR1:
+	close(fd);
+	return NULL;
+}
+
+void
+vmirror_destroy(void* buffer, uintxx size)
+{
+	if (buffer == NULL) {
+		return;
+	}
+	munmap(buffer, size << 1);
+}
+
+#else
+
+void*
+vmirror_create(uintxx size)
+{
+	(void) size;
+	return NULL;
+}
+
+void
+vmirror_destroy(void* buffer, uintxx size)
+{
+	(void) buffer;
+	(void) size;
+}
+
+#endif
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2025, jpn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef c3f0a4d2_5e1b_4f86_9b7a_2d64e8c1f357
+#define c3f0a4d2_5e1b_4f86_9b7a_2d64e8c1f357
+
+/*
+ * vmirror.h
+ * Mirrored memory mappings (internal use only).
+ *
+ * A mirrored buffer of size n spans 2n bytes of address space, the second
+ * half maps the same pages as the first one, so byte i and byte i + n are
+ * the same memory. The size must be a multiple of the allocation
+ * granularity of the system (the page size, 64KiB on Windows).
+ *
+ * Not every system supports it, the callers must provide a fallback path
+ * for when vmirror_create returns NULL. */
+
+#include <ctoolbox/ctoolbox.h>
+
+
+/* Returns the first half of the mapping or NULL on failure. */
+void* vmirror_create(uintxx size);
+
+/* Releases a mapping returned by vmirror_create. */
+void vmirror_destroy(void* buffer, uintxx size);
+
+#endif
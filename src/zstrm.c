@@ -15,6 +15,7 @@
  */
 
 #include <jdeflate/zstrm.h>
+#include "threads.h"
 
 
 #define IOBFFRSIZE 32768
@@ -45,6 +46,12 @@ struct TZStrmPrvt {
 	struct TDeflator* defltr;
 	struct TInflator* infltr;
 
+	/* parallel deflate state (only with ZSTRM_PARALLEL) */
+	struct TZStrmPool* pool;
+
+	/* throughput target set using zstrm_settarget */
+	uintxx speed;
+
 	/* last result from inflator_inflate of deflator_deflate */
 	uint32 result;
 
@@ -77,6 +84,11 @@ extern uint32 zstrm_adler32updateASM(uint32, const uint8*, uintxx);
 #define ZSTRM_MODEMASK 0x000f0000
 #define ZSTRM_TYPEMASK 0x00f00000
 
+
+static bool createpool(struct TZStrmPrvt*);
+static void destroypool(struct TZStrmPrvt*);
+static void resetpool(struct TZStrmPrvt*);
+
 const TZStrm*
 zstrm_create(uintxx flags, intxx level, const TAllocator* allctr)
 {
@@ -100,7 +112,7 @@ zstrm_create(uintxx flags, intxx level, const TAllocator* allctr)
 	if (smode == ZSTRM_DEFLATE) {
 		uintxx invalid;
 
-		if (level > 9 || level < 0) {
+		if (level > 12 || level < 0) {
 			/* invalid compression level */
 			return NULL;
 		}
@@ -125,6 +137,8 @@ zstrm_create(uintxx flags, intxx level, const TAllocator* allctr)
 		return NULL;
 	}
 	zstrm->allctr = allctr;
+	zstrm->pool   = NULL;
+	zstrm->speed  = 0;
 
 	if (smode == ZSTRM_INFLATE) {
 		uint32 f;
@@ -148,6 +162,13 @@ zstrm_create(uintxx flags, intxx level, const TAllocator* allctr)
 			return NULL;
 		}
 		zstrm->public.level = (int32) level;
+
+		if (flags & ZSTRM_PARALLEL) {
+			if (createpool(zstrm) == 0) {
+				zstrm_destroy(&zstrm->public);
+				return NULL;
+			}
+		}
 	}
 
 	zstrm->public.smode = smode;
@@ -188,6 +209,9 @@ zstrm_destroy(const TZStrm* state)
 	if (zstrm->defltr) {
 		deflator_destroy(zstrm->defltr);
 	}
+	if (zstrm->pool) {
+		destroypool(zstrm);
+	}
 
 	n = sizeof(struct TZStrmPrvt);
 	zstrm->allctr->dispose(zstrm, n, zstrm->allctr->user);
@@ -224,6 +248,9 @@ zstrm_reset(const TZStrm* state)
 	}
 	else {
 		deflator_reset(zstrm->defltr);
+		if (zstrm->pool) {
+			resetpool(zstrm);
+		}
 	}
 
 	/* IO */
@@ -309,6 +336,8 @@ zstrm_settargetfn(const TZStrm* state, TZStrmOFn fn, void* user)
 
 static uintxx parsehead(struct TZStrmPrvt*);
 
+static void setpooldctnr(struct TZStrmPrvt*, const uint8*, uintxx);
+
 
 #if defined(ZSTRM_CRC32EXTERNALASM)
 	#define CRC32UPDATE zstrm_crc32updateASM
@@ -379,6 +408,9 @@ zstrm_setdctnr(const TZStrm* state, const uint8* dict, uintxx size)
 		zstrm->public.dictid = ADLER32UPDATE(1, dict, size);
 		zstrm->public.dict   = 1;
 		deflator_setdctnr(zstrm->defltr, dict, size);
+		if (zstrm->pool) {
+			setpooldctnr(zstrm, dict, size);
+		}
 	}
 	return;
 
@@ -1035,7 +1067,7 @@ emitzlibhead(struct TZStrmPrvt* zstrm)
 	}
 
 	/* fcheck */
-	b = b + (31 - ((a << 8) | b % 31));
+	b = b + (31 - (((a << 8) | b) % 31));
 
 	emitbyte(zstrm, (uint8) a);
 	emitbyte(zstrm, (uint8) b);
@@ -1054,6 +1086,10 @@ emitzlibhead(struct TZStrmPrvt* zstrm)
 
 static uintxx deflate(struct TZStrmPrvt*, const uint8*, uintxx);
 
+static bool   startpool(struct TZStrmPrvt*);
+static uintxx pdeflate(struct TZStrmPrvt*, const uint8*, uintxx);
+static void   pflush(struct TZStrmPrvt*, uintxx final);
+
 
 #define DEFLTBFFRSIZE (IOBFFRSIZE >> 1)
 
@@ -1081,7 +1117,12 @@ zstrm_deflate(const TZStrm* state, const void* source, uintxx n)
 			SETERROR(ZSTRM_ELIMIT);
 			return 0;
 		}
-		r = deflate(zstrm, source, n);
+		if (zstrm->pool) {
+			r = pdeflate(zstrm, source, n);
+		}
+		else {
+			r = deflate(zstrm, source, n);
+		}
 		zstrm->public.total += r;
 		return r;
 	}
@@ -1098,6 +1139,11 @@ zstrm_deflate(const TZStrm* state, const void* source, uintxx n)
 			case ZSTRM_GZIP: emitgziphead(zstrm); break;
 			case ZSTRM_ZLIB: emitzlibhead(zstrm); break;
 		}
+		if (zstrm->pool) {
+			if (startpool(zstrm) == 0) {
+				SETERROR(ZSTRM_EOOM);
+			}
+		}
 		if (zstrm->public.error) {
 			SETSTATE(4);
 			return 0;
@@ -1230,6 +1276,729 @@ deflate(struct TZStrmPrvt* zstrm, const uint8* buffer, uintxx total)
 #endif
 
 
+/* ***************************************************************************
+ * Parallel deflate
+ *************************************************************************** */
+
+/* Size of each independent chunk and of the dictionary used to prime it */
+#define PCHUNKSIZE 131072
+#define PDCTNRSIZE  32768
+
+#define PMAXTHREADS 64
+
+/* job states */
+#define PJOBFREE   0
+#define PJOBQUEUED 1
+#define PJOBDONE   2
+
+
+struct TZStrmJob {
+	uint32 state;
+	uint32 flush;
+	uint32 error;
+
+	/* checksums of the chunk (the dictionary is not included) */
+	uint32 crc;
+	uint32 adler;
+
+	/* input buffer: dsize bytes of dictionary followed by isize bytes of
+	 * data to compress */
+	uint8* input;
+	uintxx dsize;
+	uintxx isize;
+
+	/* compressed data */
+	uint8* output;
+	uintxx osize;
+	uintxx ocapacity;
+};
+
+struct TZStrmPool {
+	/* jobs ring, the pending jobs (submitted but not yet written) start at
+	 * head, the job that is being filled follows the last pending one */
+	struct TZStrmJob* jobs;
+	uintxx njobs;
+	uintxx head;
+	uintxx npending;
+
+	/* next job to be taken by a worker and number of queued jobs */
+	uintxx next;
+	uintxx nqueued;
+
+	uintxx nthreads;
+	uint32 running;
+	uint32 quit;
+
+#if defined(JDEFLATE_THREADS)
+	TMutex mutex;
+	TCondition work;
+	TCondition done;
+
+	struct TZStrmWorker {
+		struct TZStrmPrvt* zstrm;
+		struct TDeflator* defltr;
+
+		TThread thread;
+	}
+	workers[PMAXTHREADS];
+#endif
+
+	/* dictionary set using zstrm_setdctnr */
+	uintxx dctnrsize;
+	uint8  dctnr[PDCTNRSIZE];
+};
+
+
+static bool
+createpool(struct TZStrmPrvt* zstrm)
+{
+	struct TZStrmPool* pool;
+	const struct TAllocator* a;
+
+	a = zstrm->allctr;
+	pool = a->request(sizeof(struct TZStrmPool), a->user);
+	if (pool == NULL) {
+		return 0;
+	}
+
+	pool->jobs  = NULL;
+	pool->njobs = 0;
+	pool->head     = 0;
+	pool->npending = 0;
+	pool->next     = 0;
+	pool->nqueued  = 0;
+	pool->running = 0;
+	pool->quit    = 0;
+	pool->dctnrsize = 0;
+
+	pool->nthreads = 0;
+#if defined(JDEFLATE_THREADS)
+	pool->nthreads = thread_cpucount();
+	if (pool->nthreads > PMAXTHREADS) {
+		pool->nthreads = PMAXTHREADS;
+	}
+#endif
+
+	zstrm->pool = pool;
+	return 1;
+}
+
+static void
+freejobs(struct TZStrmPrvt* zstrm)
+{
+	uintxx i;
+	struct TZStrmPool* pool;
+	const struct TAllocator* a;
+
+	a = zstrm->allctr;
+	pool = zstrm->pool;
+	if (pool->jobs == NULL) {
+		return;
+	}
+
+	for (i = 0; i < pool->njobs; i++) {
+		struct TZStrmJob* job;
+
+		job = pool->jobs + i;
+		if (job->input) {
+			a->dispose(job->input, PDCTNRSIZE + PCHUNKSIZE, a->user);
+		}
+		if (job->output) {
+			a->dispose(job->output, job->ocapacity, a->user);
+		}
+	}
+	a->dispose(pool->jobs, pool->njobs * sizeof(struct TZStrmJob), a->user);
+	pool->jobs  = NULL;
+	pool->njobs = 0;
+}
+
+static bool
+allocatejobs(struct TZStrmPrvt* zstrm, uintxx njobs)
+{
+	uintxx i;
+	struct TZStrmPool* pool;
+	const struct TAllocator* a;
+
+	a = zstrm->allctr;
+	pool = zstrm->pool;
+
+	pool->jobs = a->request(njobs * sizeof(struct TZStrmJob), a->user);
+	if (pool->jobs == NULL) {
+		return 0;
+	}
+	pool->njobs = njobs;
+
+	for (i = 0; i < njobs; i++) {
+		struct TZStrmJob* job;
+
+		job = pool->jobs + i;
+		job->state = PJOBFREE;
+		job->ocapacity = PCHUNKSIZE + (PCHUNKSIZE >> 3) + 1024;
+		job->input  = a->request(PDCTNRSIZE + PCHUNKSIZE, a->user);
+		job->output = a->request(job->ocapacity, a->user);
+	}
+	for (i = 0; i < njobs; i++) {
+		if (pool->jobs[i].input == NULL || pool->jobs[i].output == NULL) {
+			freejobs(zstrm);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void
+stoppool(struct TZStrmPrvt* zstrm)
+{
+	struct TZStrmPool* pool;
+
+	pool = zstrm->pool;
+	if (pool->running == 0) {
+		return;
+	}
+
+#if defined(JDEFLATE_THREADS)
+	if (pool->nthreads) {
+		uintxx i;
+
+		mutex_lock(&pool->mutex);
+		pool->quit = 1;
+		cond_broadcast(&pool->work);
+		mutex_unlock(&pool->mutex);
+
+		for (i = 0; i < pool->nthreads; i++) {
+			thread_join(&pool->workers[i].thread);
+			deflator_destroy(pool->workers[i].defltr);
+		}
+		cond_destroy(&pool->done);
+		cond_destroy(&pool->work);
+		mutex_destroy(&pool->mutex);
+	}
+#endif
+
+	freejobs(zstrm);
+	pool->running = 0;
+	pool->quit    = 0;
+}
+
+static void
+destroypool(struct TZStrmPrvt* zstrm)
+{
+	const struct TAllocator* a;
+
+	a = zstrm->allctr;
+	stoppool(zstrm);
+	a->dispose(zstrm->pool, sizeof(struct TZStrmPool), a->user);
+	zstrm->pool = NULL;
+}
+
+/* Creates the job ring and seeds the first job with the dictionary */
+static void
+beginpool(struct TZStrmPrvt* zstrm)
+{
+	struct TZStrmPool* pool;
+	struct TZStrmJob* job;
+
+	pool = zstrm->pool;
+	pool->head     = 0;
+	pool->npending = 0;
+	pool->next     = 0;
+	pool->nqueued  = 0;
+
+	job = pool->jobs;
+	job->dsize = pool->dctnrsize;
+	job->isize = 0;
+	if (job->dsize) {
+		ctb_memcpy(job->input, pool->dctnr, job->dsize);
+	}
+}
+
+static void
+setpooldctnr(struct TZStrmPrvt* zstrm, const uint8* dict, uintxx size)
+{
+	struct TZStrmPool* pool;
+
+	pool = zstrm->pool;
+	if (size > PDCTNRSIZE) {
+		dict = (dict + size) - PDCTNRSIZE;
+		size = PDCTNRSIZE;
+	}
+	ctb_memcpy(pool->dctnr, dict, size);
+	pool->dctnrsize = size;
+}
+
+static void
+runjob(struct TZStrmPrvt* zstrm, struct TDeflator* defltr, struct TZStrmJob* j)
+{
+	uintxx result;
+	const uint8* chunk;
+
+	chunk = j->input + j->dsize;
+
+	j->crc   = 0;
+	j->adler = 1;
+	if (zstrm->docrc) {
+		j->crc = zstrm_crc32update(0, chunk, j->isize);
+	}
+	if (zstrm->doadler) {
+		j->adler = zstrm_adler32update(1, chunk, j->isize);
+	}
+
+	deflator_reset(defltr);
+	if (zstrm->speed) {
+		deflator_settarget(defltr, zstrm->speed);
+	}
+	if (j->dsize) {
+		deflator_setdctnr(defltr, j->input, j->dsize);
+	}
+	deflator_setsrc(defltr, chunk, j->isize);
+
+	j->osize = 0;
+	do {
+		if (j->osize == j->ocapacity) {
+			uint8* buffer;
+			const struct TAllocator* a;
+
+			a = zstrm->allctr;
+			buffer = a->request(j->ocapacity << 1, a->user);
+			if (buffer == NULL) {
+				j->error = ZSTRM_EOOM;
+				return;
+			}
+			ctb_memcpy(buffer, j->output, j->osize);
+			a->dispose(j->output, j->ocapacity, a->user);
+
+			j->output = buffer;
+			j->ocapacity <<= 1;
+		}
+
+		deflator_settgt(defltr, j->output + j->osize, j->ocapacity - j->osize);
+		result = deflator_deflate(defltr, j->flush);
+		j->osize += deflator_tgtend(defltr);
+	} while (result == DEFLT_TGTEXHSTD);
+
+	if (result != DEFLT_OK) {
+		j->error = ZSTRM_EDEFLATE;
+	}
+}
+
+
+#if defined(JDEFLATE_THREADS)
+
+THREADPROC(workerloop)
+{
+	struct TZStrmWorker* worker;
+	struct TZStrmPool* pool;
+	struct TZStrmJob* job;
+
+	worker = argument;
+	pool = worker->zstrm->pool;
+
+	mutex_lock(&pool->mutex);
+	for (;;) {
+		while (pool->quit == 0 && pool->nqueued == 0) {
+			cond_wait(&pool->work, &pool->mutex);
+		}
+		if (pool->quit) {
+			break;
+		}
+
+		job = pool->jobs + pool->next;
+		pool->next = (pool->next + 1) % pool->njobs;
+		pool->nqueued--;
+		mutex_unlock(&pool->mutex);
+
+		runjob(worker->zstrm, worker->defltr, job);
+
+		mutex_lock(&pool->mutex);
+		job->state = PJOBDONE;
+		cond_broadcast(&pool->done);
+	}
+	mutex_unlock(&pool->mutex);
+
+	THREADRETURN;
+}
+
+static bool
+startthreads(struct TZStrmPrvt* zstrm)
+{
+	uintxx i;
+	uintxx flags;
+	struct TZStrmPool* pool;
+	struct TZStrmWorker* worker;
+
+	pool = zstrm->pool;
+	if (mutex_init(&pool->mutex) == 0) {
+		return 0;
+	}
+	if (cond_init(&pool->work) == 0) {
+		mutex_destroy(&pool->mutex);
+		return 0;
+	}
+	if (cond_init(&pool->done) == 0) {
+		cond_destroy(&pool->work);
+		mutex_destroy(&pool->mutex);
+		return 0;
+	}
+
+	flags = zstrm->public.flags & 0x00ff;
+	for (i = 0; i < pool->nthreads; i++) {
+		worker = pool->workers + i;
+		worker->zstrm  = zstrm;
+		worker->defltr = deflator_create(
+			flags, zstrm->public.level, zstrm->allctr);
+		if (worker->defltr == NULL) {
+			break;
+		}
+
+		if (thread_create(&worker->thread, workerloop, worker) == 0) {
+			deflator_destroy(worker->defltr);
+			break;
+		}
+	}
+
+	if (i != pool->nthreads) {
+		/* stop the threads that we already started */
+		pool->nthreads = i;
+		pool->running  = 1;
+		stoppool(zstrm);
+		return 0;
+	}
+	return 1;
+}
+
+#endif
+
+static bool
+startpool(struct TZStrmPrvt* zstrm)
+{
+	uintxx njobs;
+	struct TZStrmPool* pool;
+
+	pool = zstrm->pool;
+	if (pool->running) {
+#if defined(JDEFLATE_THREADS)
+		if (pool->nthreads) {
+			/* the workers read the ring under the mutex */
+			mutex_lock(&pool->mutex);
+			beginpool(zstrm);
+			mutex_unlock(&pool->mutex);
+			return 1;
+		}
+#endif
+		beginpool(zstrm);
+		return 1;
+	}
+
+	njobs = pool->nthreads << 1;
+	if (njobs < 2) {
+		njobs = 2;
+	}
+	if (allocatejobs(zstrm, njobs) == 0) {
+		return 0;
+	}
+
+	/* the ring must be ready before the workers start */
+	beginpool(zstrm);
+#if defined(JDEFLATE_THREADS)
+	if (pool->nthreads) {
+		if (startthreads(zstrm) == 0) {
+			freejobs(zstrm);
+			return 0;
+		}
+	}
+#endif
+	pool->running = 1;
+	return 1;
+}
+
+/* Largest prime smaller than 65536 */
+#define PADLERBASE 65521
+
+static uint32
+adler32combine(uint32 adler1, uint32 adler2, uintxx size2)
+{
+	uint32 r;
+	uint32 a;
+	uint32 b;
+
+	r = (uint32) (size2 % PADLERBASE);
+	a = adler1 & 0xffff;
+	b = (uint32) ((r * (uint64) a) % PADLERBASE);
+
+	a += (adler2 & 0xffff) + PADLERBASE - 1;
+	b += (adler1 >> 16) + (adler2 >> 16) + PADLERBASE - r;
+	if (a >= PADLERBASE) a -= PADLERBASE;
+	if (a >= PADLERBASE) a -= PADLERBASE;
+	if (b >= PADLERBASE << 1) b -= PADLERBASE << 1;
+	if (b >= PADLERBASE) b -= PADLERBASE;
+
+	return (b << 16) | a;
+}
+
+#undef PADLERBASE
+
+static void
+waitjob(struct TZStrmPrvt* zstrm, struct TZStrmJob* job)
+{
+#if defined(JDEFLATE_THREADS)
+	struct TZStrmPool* pool;
+
+	pool = zstrm->pool;
+	if (pool->nthreads) {
+		mutex_lock(&pool->mutex);
+		while (job->state != PJOBDONE) {
+			cond_wait(&pool->done, &pool->mutex);
+		}
+		mutex_unlock(&pool->mutex);
+	}
+#else
+	(void) zstrm;
+#endif
+	CTB_ASSERT(job->state == PJOBDONE);
+}
+
+/* Waits for the oldest pending job and writes its output */
+static void
+writejob(struct TZStrmPrvt* zstrm)
+{
+	struct TZStrmPool* pool;
+	struct TZStrmJob* job;
+
+	pool = zstrm->pool;
+	job = pool->jobs + pool->head;
+	waitjob(zstrm, job);
+
+	pool->head = (pool->head + 1) % pool->njobs;
+	pool->npending--;
+	job->state = PJOBFREE;
+
+	if (zstrm->public.error) {
+		return;
+	}
+	if (job->error) {
+		SETERROR(job->error);
+		return;
+	}
+
+	if (job->osize) {
+		intxx r;
+
+		r = zstrm->iofn(job->output, job->osize, zstrm->user);
+		if ((uintxx) r > job->osize || (uintxx) r != job->osize) {
+			SETERROR(ZSTRM_EIOERROR);
+			return;
+		}
+	}
+
+	if (zstrm->docrc) {
+		zstrm->public.crc = zstrm_crc32combine(
+			zstrm->public.crc, job->crc, job->isize);
+	}
+	if (zstrm->doadler) {
+		zstrm->public.adler = adler32combine(
+			zstrm->public.adler, job->adler, job->isize);
+	}
+}
+
+/* Submits the job that is being filled and prepares the next one */
+static void
+submitjob(struct TZStrmPrvt* zstrm, uintxx flush)
+{
+	uintxx total;
+	uintxx dsize;
+	struct TZStrmPool* pool;
+	struct TZStrmJob* job;
+	struct TZStrmJob* next;
+
+	pool = zstrm->pool;
+	job = pool->jobs + ((pool->head + pool->npending) % pool->njobs);
+	job->flush = (uint32) flush;
+	job->error = 0;
+
+#if defined(JDEFLATE_THREADS)
+	if (pool->nthreads) {
+		mutex_lock(&pool->mutex);
+		job->state = PJOBQUEUED;
+		pool->nqueued++;
+		cond_signal(&pool->work);
+		mutex_unlock(&pool->mutex);
+	}
+	else {
+		runjob(zstrm, zstrm->defltr, job);
+		job->state = PJOBDONE;
+	}
+#else
+	runjob(zstrm, zstrm->defltr, job);
+	job->state = PJOBDONE;
+#endif
+
+	pool->npending++;
+	if (pool->npending == pool->njobs) {
+		writejob(zstrm);
+	}
+
+	/* the last 32 KiB of input are the dictionary of the next chunk */
+	next = pool->jobs + ((pool->head + pool->npending) % pool->njobs);
+
+	total = job->dsize + job->isize;
+	dsize = total;
+	if (dsize > PDCTNRSIZE) {
+		dsize = PDCTNRSIZE;
+	}
+	ctb_memcpy(next->input, job->input + (total - dsize), dsize);
+	next->dsize = dsize;
+	next->isize = 0;
+}
+
+static uintxx
+pdeflate(struct TZStrmPrvt* zstrm, const uint8* buffer, uintxx total)
+{
+	const uint8* bbgn;
+	struct TZStrmPool* pool;
+	struct TZStrmJob* job;
+
+	pool = zstrm->pool;
+
+	bbgn = buffer;
+	while (total) {
+		uintxx maxrun;
+
+		job = pool->jobs + ((pool->head + pool->npending) % pool->njobs);
+
+		maxrun = PCHUNKSIZE - job->isize;
+		if (maxrun > total) {
+			maxrun = total;
+		}
+		ctb_memcpy(job->input + job->dsize + job->isize, buffer, maxrun);
+		job->isize += maxrun;
+		buffer += maxrun;
+		total  -= maxrun;
+
+		if (job->isize == PCHUNKSIZE) {
+			submitjob(zstrm, DEFLT_FLUSH);
+			if (zstrm->public.error) {
+				SETSTATE(4);
+				break;
+			}
+		}
+	}
+
+	return (uintxx) (buffer - bbgn);
+}
+
+static void
+pflush(struct TZStrmPrvt* zstrm, uintxx final)
+{
+	struct TZStrmPool* pool;
+	struct TZStrmJob* job;
+	uintxx empty;
+
+	pool = zstrm->pool;
+	job = pool->jobs + ((pool->head + pool->npending) % pool->njobs);
+
+	empty = job->isize == 0;
+	if (empty == 0) {
+		submitjob(zstrm, final ? DEFLT_END : DEFLT_FLUSH);
+	}
+
+	while (pool->npending) {
+		writejob(zstrm);
+	}
+	if (zstrm->public.error) {
+		return;
+	}
+
+	if (empty) {
+		/* an empty stored block, this is the same output a deflator would
+		 * produce with no input */
+		emitbyte(zstrm, final ? 0x01 : 0x00);
+		emitbyte(zstrm, 0x00);
+		emitbyte(zstrm, 0x00);
+		emitbyte(zstrm, 0xff);
+		emitbyte(zstrm, 0xff);
+		emittarget(zstrm);
+	}
+}
+
+static void
+resetpool(struct TZStrmPrvt* zstrm)
+{
+	struct TZStrmPool* pool;
+
+	pool = zstrm->pool;
+	if (pool->running) {
+		/* discard any pending job */
+		while (pool->npending) {
+			struct TZStrmJob* job;
+
+			job = pool->jobs + pool->head;
+			waitjob(zstrm, job);
+			job->state = PJOBFREE;
+
+			pool->head = (pool->head + 1) % pool->njobs;
+			pool->npending--;
+		}
+	}
+	pool->dctnrsize = 0;
+}
+
+void
+zstrm_setnthreads(const TZStrm* state, uintxx n)
+{
+	struct TZStrmPrvt* zstrm;
+	CTB_ASSERT(state);
+
+	zstrm = CTB_CONSTCAST(state);
+	if (zstrm->pool == NULL || zstrm->public.state > 1) {
+		SETSTATE(4);
+		if (zstrm->public.error == 0) {
+			SETERROR(ZSTRM_EINCORRECTUSE);
+		}
+		return;
+	}
+
+#if defined(JDEFLATE_THREADS)
+	if (n > PMAXTHREADS) {
+		n = PMAXTHREADS;
+	}
+#else
+	n = 0;
+#endif
+	if (n != zstrm->pool->nthreads) {
+		stoppool(zstrm);
+		zstrm->pool->nthreads = n;
+	}
+}
+
+void
+zstrm_settarget(const TZStrm* state, uintxx speed)
+{
+	struct TZStrmPrvt* zstrm;
+	CTB_ASSERT(state);
+
+	zstrm = CTB_CONSTCAST(state);
+	if (zstrm->public.smode != ZSTRM_DEFLATE || zstrm->public.state > 1) {
+		SETSTATE(4);
+		if (zstrm->public.error == 0) {
+			SETERROR(ZSTRM_EINCORRECTUSE);
+		}
+		return;
+	}
+
+	/* the workers take it when they start a chunk */
+	zstrm->speed = speed;
+	deflator_settarget(zstrm->defltr, speed);
+}
+
+#undef PCHUNKSIZE
+#undef PDCTNRSIZE
+#undef PMAXTHREADS
+
+#undef PJOBFREE
+#undef PJOBQUEUED
+#undef PJOBDONE
+
+
 CTB_INLINE void
 emitgziptail(struct TZStrmPrvt* zstrm)
 {
@@ -1294,7 +2063,12 @@ zstrm_flush(const TZStrm* state, uint32 final)
 	if (final) {
 		flush = DEFLT_END;
 	}
-	dochunk(zstrm, flush, zstrm->source, total);
+	if (zstrm->pool) {
+		pflush(zstrm, final);
+	}
+	else {
+		dochunk(zstrm, flush, zstrm->source, total);
+	}
 	if (zstrm->public.error) {
 		SETSTATE(4);
 		return;
@@ -1383,7 +2157,11 @@ zstrm_adler32update(uint32 chcksm, const uint8* data, uintxx size)
 		size--;
 	}
 
-	/* modulo reduction */
+	/* modulo reduction (a single fold can leave b above the modulus) */
+	ra = a >> 16;
+	rb = b >> 16;
+	a = (a & 0xffff) + ((ra << 4) - ra);
+	b = (b & 0xffff) + ((rb << 4) - rb);
 	ra = a >> 16;
 	rb = b >> 16;
 	a = (a & 0xffff) + ((ra << 4) - ra);
@@ -1425,7 +2203,7 @@ GF2_matrixtimes(const uint32* matrix, uint32 index)
 }
 
 uint32
-crc32_ncombine(uint32 crc1, uint32 crc2, uint32 size2)
+zstrm_crc32combine(uint32 crc1, uint32 crc2, uintxx size2)
 {
 	uintxx i;
 
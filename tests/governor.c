@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2025, jpn
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks that DEFLT_PIPELINE gives the same output as the serial encoder
+ * while the governor moves the level. The targets are far from any real
+ * throughput so the level changes do not depend on the machine.
+ */
+
+#include <jdeflate/deflator.h>
+#include <jdeflate/inflator.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define SOURCESIZE 0x400000
+#define CHUNKSIZE  0x40000
+#define TARGETSIZE 0x10000
+
+/* MB/s, the level goes down with the first and up with the second */
+#define FASTTARGET 1000000
+#define SLOWTARGET 1
+
+
+static uint32
+rng(uint32* seed)
+{
+	seed[0] = seed[0] * 1103515245 + 12345;
+	return seed[0] >> 16;
+}
+
+/* Text like data with some incompressible runs */
+static void
+fillsource(uint8* source, uintxx size)
+{
+	static const char* words[] = {
+		"the ", "deflate ", "stream ", "of ", "block ", "and ", "level ",
+		"match ", "a ", "window ", "literal ", "to ", "length ", "\n"
+	};
+	uintxx i;
+	uint32 seed;
+
+	seed = 1;
+	for (i = 0; i < size;) {
+		if ((rng(&seed) & 0x3ff) == 0) {
+			uintxx n;
+
+			n = 1024 + (rng(&seed) & 0x1fff);
+			for (; n && i < size; n--) {
+				source[i++] = (uint8) rng(&seed);
+			}
+		}
+		else {
+			const char* w;
+
+			w = words[rng(&seed) % (sizeof(words) / sizeof(words[0]))];
+			for (; *w && i < size; w++) {
+				source[i++] = (uint8) *w;
+			}
+		}
+	}
+}
+
+/* Compresses the source with the target changed every few chunks, returns
+ * the compressed size or zero on error */
+static uintxx
+compress(uintxx flags, intxx level, const uint8* source, uint8* target,
+	uintxx tsize)
+{
+	uintxx i;
+	uintxx n;
+	uintxx total;
+	eDEFLTResult r;
+	TDeflator* deflator;
+
+	deflator = deflator_create(DEFLT_GOVERNOR | flags, level, NULL);
+	if (deflator == NULL) {
+		return 0;
+	}
+
+	total = 0;
+	for (i = 0; i < SOURCESIZE; i += CHUNKSIZE) {
+		if ((i / CHUNKSIZE) & 4) {
+			deflator_settarget(deflator, SLOWTARGET);
+		}
+		else {
+			deflator_settarget(deflator, FASTTARGET);
+		}
+
+		deflator_setsrc(deflator, source + i, CHUNKSIZE);
+		do {
+			n = tsize - total;
+			if (n > TARGETSIZE) {
+				n = TARGETSIZE;
+			}
+			if (n == 0) {
+				deflator_destroy(deflator);
+				return 0;
+			}
+
+			deflator_settgt(deflator, target + total, n);
+			if (i + CHUNKSIZE == SOURCESIZE) {
+				r = deflator_deflate(deflator, DEFLT_END);
+			}
+			else {
+				r = deflator_deflate(deflator, DEFLT_NOFLUSH);
+			}
+			total += deflator_tgtend(deflator);
+		} while (r == DEFLT_TGTEXHSTD);
+
+		if (r == DEFLT_ERROR) {
+			deflator_destroy(deflator);
+			return 0;
+		}
+	}
+
+	deflator_destroy(deflator);
+	if (r != DEFLT_OK) {
+		return 0;
+	}
+	return total;
+}
+
+static bool
+decompress(const uint8* source, uintxx size, const uint8* expected)
+{
+	uint8* target;
+	bool ok;
+	eINFLTResult r;
+	TInflator* inflator;
+
+	inflator = inflator_create(0, NULL);
+	target = malloc(SOURCESIZE + 1);
+	if (inflator == NULL || target == NULL) {
+		free(target);
+		if (inflator) {
+			inflator_destroy(inflator);
+		}
+		return 0;
+	}
+
+	inflator_setsrc(inflator, source, size);
+	inflator_settgt(inflator, target, SOURCESIZE + 1);
+	r = inflator_inflate(inflator, 1);
+
+	ok = r == INFLT_OK && inflator_tgtend(inflator) == SOURCESIZE;
+	if (ok) {
+		ok = memcmp(target, expected, SOURCESIZE) == 0;
+	}
+	inflator_destroy(inflator);
+	free(target);
+	return ok;
+}
+
+int
+main(void)
+{
+	intxx level;
+	uintxx tsize;
+	uintxx serial;
+	uintxx piped;
+	uint8* source;
+	uint8* target1;
+	uint8* target2;
+	int failures;
+
+	tsize = SOURCESIZE + (SOURCESIZE >> 3) + 4096;
+	source  = malloc(SOURCESIZE);
+	target1 = malloc(tsize);
+	target2 = malloc(tsize);
+	if (source == NULL || target1 == NULL || target2 == NULL) {
+		fputs("out of memory\n", stderr);
+		return 1;
+	}
+	fillsource(source, SOURCESIZE);
+
+	failures = 0;
+	for (level = 1; level <= 7; level++) {
+		serial = compress(0, level, source, target1, tsize);
+		piped  = compress(DEFLT_PIPELINE, level, source, target2, tsize);
+		if (serial == 0 || piped == 0) {
+			fprintf(stderr, "level %d: compression failed\n", (int) level);
+			failures++;
+			continue;
+		}
+
+		if (serial != piped || memcmp(target1, target2, serial)) {
+			fprintf(stderr,
+				"level %d: pipelined output differs (%lu and %lu bytes)\n",
+				(int) level, (unsigned long) serial, (unsigned long) piped);
+			failures++;
+			continue;
+		}
+		if (decompress(target1, serial, source) == 0) {
+			fprintf(stderr, "level %d: bad round trip\n", (int) level);
+			failures++;
+		}
+	}
+
+	free(source);
+	free(target1);
+	free(target2);
+	return failures != 0;
+}